@@ -0,0 +1,137 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "include/Parameters.h"
+
+namespace {
+
+// allowed CPUs of the process grouped by socket, CPUs of every socket in increasing order
+struct Topology {
+    std::vector <int> socket;  // by CPU number
+    std::vector <std::vector <int>> cpus;
+    cpu_set_t mask;            // of the process before any thread was bound
+
+    Topology() : socket(), cpus(), mask() {
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+            return;
+        }
+        std::map <int, std::vector <int>> bySocket;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &mask)) {
+                continue;
+            }
+            const std::string name = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/physical_package_id";
+            std::ifstream fPackage(name);
+            int package = 0;
+            if (!(fPackage >> package)) {
+                package = 0;
+            }
+            bySocket[package].push_back(cpu);
+            socket.resize(cpu + 1, 0);
+        }
+        for (auto& s : bySocket) {
+            for (int cpu : s.second) {
+                socket[cpu] = static_cast <int> (cpus.size());
+            }
+            cpus.push_back(s.second);
+        }
+    }
+};
+
+const Topology& topology() {
+    static const Topology topology;
+    return topology;
+}
+
+// CPU of every thread
+std::vector <int> placement(Affinity affinity, int nThreads) {
+    const Topology& t = topology();
+    std::vector <int> order;
+    if (affinity == Affinity::Compact) {
+        for (const std::vector <int>& cpus : t.cpus) {
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        }
+    } else {
+        size_t maxSize = 0;
+        for (const std::vector <int>& cpus : t.cpus) {
+            maxSize = std::max(maxSize, cpus.size());
+        }
+        for (size_t i = 0; i < maxSize; ++i) {
+            for (const std::vector <int>& cpus : t.cpus) {
+                if (i < cpus.size()) {
+                    order.push_back(cpus[i]);
+                }
+            }
+        }
+    }
+
+    std::vector <int> cpu(nThreads, 0);
+    for (int n = 0; (n < nThreads) && !order.empty(); ++n) {
+        cpu[n] = order[n % order.size()];
+    }
+    return cpu;
+}
+
+// socket of the calling thread, -1 until it is resolved
+thread_local int threadSocket = -1;
+
+}  // namespace
+
+int nSockets() {
+    return std::max(1, static_cast <int> (topology().cpus.size()));
+}
+
+int socketOfCpu(int cpu) {
+    const std::vector <int>& socket = topology().socket;
+    return ((cpu >= 0) && (static_cast <size_t> (cpu) < socket.size())) ? socket[cpu] : 0;
+}
+
+int currentSocket() {
+    if (threadSocket < 0) {
+        threadSocket = socketOfCpu(sched_getcpu());
+    }
+    return threadSocket;
+}
+
+void setThreads(const Parameters& data) {
+    omp_set_num_threads(data.Nt);
+    const bool bind = (data.affinity != Affinity::None) && !topology().cpus.empty();
+    const std::vector <int> cpu = bind ? placement(data.affinity, data.Nt) : std::vector <int> ();
+    #pragma omp parallel
+    {
+        if (bind) {
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            CPU_SET(cpu[omp_get_thread_num()], &mask);
+            pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+        }
+        threadSocket = socketOfCpu(sched_getcpu());
+    }
+}
+
+void unbindThread() {
+    const Topology& t = topology();
+    if (!t.cpus.empty()) {
+        pthread_setaffinity_np(pthread_self(), sizeof(t.mask), &t.mask);
+    }
+    threadSocket = -1;
+}
@@ -0,0 +1,163 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Autotune.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include <boost/format.hpp>
+
+#include "include/Figures.h"
+#include "include/integrator.h"
+#include "include/Parameters.h"
+#include "include/validation.h"
+
+namespace {
+
+// integrator configuration tried by autotune()
+struct Candidate {
+ public:
+    double Ct;
+    int richardson;
+    Stepper forcedStepper;
+    Stepper freeStepper;
+
+    Parameters apply(const Parameters& data) const {
+        return data.withCt(Ct).withRichardson(richardson).withSteppers(forcedStepper, freeStepper);
+    }
+
+    std::string name() const {
+        return (boost::format("Ct=%.3lg richardson=%d %s/%s") % Ct % richardson % stepperName(forcedStepper) \
+                                                             % stepperName(freeStepper)).str();
+    }
+};
+
+std::vector <Candidate> candidates(const Parameters& data) {
+    std::vector <Candidate> all = {{data.Ct, data.richardson, data.forcedStepper, data.freeStepper}};
+    for (double Ct : {0.05, 0.1, 0.2, 0.5, 1.0}) {
+        all.push_back({Ct, 1, Stepper::RungeKutta, Stepper::RungeKutta});
+    }
+    for (int levels : {2, 3}) {
+        for (double Ct : {0.1, 0.2, 0.5}) {
+            all.push_back({Ct, levels, Stepper::RungeKutta, Stepper::RungeKutta});
+        }
+    }
+    // reducers sample the steps, which are too long for them with the Magnus stepper
+    for (Stepper forced : {Stepper::RungeKutta, Stepper::Magnus}) {
+        for (Stepper free : {Stepper::RungeKutta, Stepper::Magnus}) {
+            if (((forced != Stepper::RungeKutta) || (free != Stepper::RungeKutta)) && data.reducers.empty()) {
+                all.push_back({data.Ct, 1, forced, free});
+            }
+        }
+    }
+
+    // the configuration of data stays the first one
+    std::vector <Candidate> result;
+    for (const Candidate& candidate : all) {
+        if (std::none_of(result.begin(), result.end(), [&candidate](const Candidate& c) {
+                return c.name() == candidate.name(); })) {
+            result.push_back(candidate);
+        }
+    }
+    return result;
+}
+
+// cells requested by figure, nothing is integrated
+std::vector <ValidationCase> recordCells(const Parameters& data, const Figure& figure) {
+    std::vector <ValidationCase> cells;
+    std::mutex mutex;
+    figure(data, [&cells, &mutex](const Parameters& d, double kxMin, double kxMax, double ky, double kz,
+                                  IntegratorOut& error, CellCounters*) {
+        std::lock_guard <std::mutex> lock(mutex);
+        cells.push_back({kxMin, kxMax, ky, kz, d.invRe, d.invRe_b, Forcing::Flat, IntegratorOut()});
+        error = IntegratorOut();
+        return IntegratorOut();
+    }, false);
+    return cells;
+}
+
+// n cells at evenly spaced quantiles of |k| at the start of the cell, the cost of a cell grows with it
+std::vector <ValidationCase> sampleCells(std::vector <ValidationCase> cells, size_t n) {
+    auto norm = [](const ValidationCase& c) {
+        return std::sqrt(c.kxMin * c.kxMin + c.ky * c.ky + c.kz * c.kz);
+    };
+    std::sort(cells.begin(), cells.end(), [&norm](const ValidationCase& a, const ValidationCase& b) {
+        return norm(a) < norm(b);
+    });
+    if (cells.size() <= n) {
+        return cells;
+    }
+    std::vector <ValidationCase> samples;
+    for (size_t i = 0; i < n; ++i) {
+        samples.push_back(cells[(n > 1) ? i * (cells.size() - 1) / (n - 1) : cells.size() / 2]);
+    }
+    return samples;
+}
+
+}  // namespace
+
+Parameters autotune(const Parameters& data, const Figure& figure, size_t nSamples, double referenceCt) {
+    if (data.autotune <= 0) {
+        return data;
+    }
+
+    const Parameters tuneData = data.withoutReports();
+    const std::vector <ValidationCase> cells = recordCells(tuneData, figure);
+    if (cells.size() <= nSamples) {
+        // tuning would integrate every cell several times, more than the run itself
+        fprintf(stderr, "Autotune: skipped for %zu cells\n", cells.size());
+        return data;
+    }
+    std::vector <ValidationCase> samples = sampleCells(cells, nSamples);
+    computeReference(tuneData, samples, referenceCt);
+
+    const std::vector <Candidate> configurations = candidates(data);
+    std::vector <Mode> modes;
+    for (const Candidate& candidate : configurations) {
+        modes.push_back({candidate.name(), [candidate](const Parameters& d, const ValidationCase& c) {
+            IntegratorOut error;
+            return evaluateCell(candidate.apply(d), c.kxMin, c.kxMax, c.ky, c.kz, error, nullptr); }});
+    }
+    const std::vector <ModeReport> reports = validate(tuneData, samples, modes);
+
+    const size_t none = reports.size();
+    size_t best = none;
+    for (size_t n = 0; n < reports.size(); ++n) {
+        if ((reports[n].maxError <= data.autotune) && ((best == none) || (reports[n].time < reports[best].time))) {
+            best = n;
+        }
+    }
+    if (best == none) {
+        best = 0;
+        for (size_t n = 1; n < reports.size(); ++n) {
+            if (reports[n].maxError < reports[best].maxError) {
+                best = n;
+            }
+        }
+    }
+
+    fprintf(stdout, "Autotune on %zu of %zu cells, reference Ct = %lg\n", samples.size(), cells.size(), referenceCt);
+    fprintf(stdout, "%-36s %12s %12s %10s %s\n", "configuration", "max error", "mean error", "time, s", "chosen");
+    for (size_t n = 0; n < reports.size(); ++n) {
+        fprintf(stdout, "%-36s %12.3le %12.3le %10.3lf %s\n", reports[n].name.c_str(), reports[n].maxError,
+                reports[n].meanError, reports[n].time, (n == best) ? "*" : "");
+    }
+
+    if (reports[best].maxError > data.autotune) {
+        fprintf(stderr, "Autotune: no configuration meets tolerance %lg, using the most accurate\n", data.autotune);
+    }
+
+    const Parameters tuned = configurations[best].apply(data);
+    fprintf(stdout, "%s\n", tuned.integrator2Str().c_str());
+    return tuned;
+}
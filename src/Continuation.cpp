@@ -0,0 +1,111 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Continuation.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <cmath>
+
+#include "include/Affinity.h"
+#include "include/integrator.h"
+#include "include/Parameters.h"
+#include "include/Progress.h"
+#include "include/validation.h"
+
+Continuation::Continuation(const Parameters& data, const std::vector <ContinuationCell>& cells, double tolerance,
+                           int maxSkip) :
+    _data(data),
+    _cells(cells),
+    _tolerance(tolerance),
+    _maxSkip(maxSkip),
+    _history(cells.size(), History{0, {{0, 0, 0}}, {{IntegratorOut(), IntegratorOut(), IntegratorOut()}}, 1, 0, true}),
+    _iOuts(cells.size()),
+    _s(0),
+    _x(0),
+    _y(0),
+    _first(true) {}
+
+IntegratorOut Continuation::predict(const History& h, double s, int first) const {
+    // Lagrange polynomial through the points first, ..., h.n - 1
+    IntegratorOut iOut;
+    for (int i = first; i < h.n; ++i) {
+        double w = 1;
+        for (int j = first; j < h.n; ++j) {
+            if (j != i) {
+                w *= (s - h.s[j]) / (h.s[i] - h.s[j]);
+            }
+        }
+        iOut += h.iOut[i] * w;
+    }
+    return iOut;
+}
+
+const std::vector <IntegratorOut>& Continuation::step(double invRe, double invRe_b) {
+    if (!(invRe > 0)) {
+        throw std::invalid_argument("Continuation: R must be finite");
+    }
+    const Parameters data = _data.withInvRe(invRe, invRe_b);
+
+    // path length in log-space of the dissipation coefficients, R_b,eff is finite whenever R is
+    const double x = std::log(invRe);
+    const double y = std::log(invRe_b + invRe / 3.0);
+    if (_first) {
+        _first = false;
+        _s = 0;
+    } else {
+        const double dx = x - _x;
+        const double dy = y - _y;
+        _s += std::sqrt(dx * dx + dy * dy);
+    }
+    _x = x;
+    _y = y;
+    const double s = _s;
+
+    const int N = static_cast <int> (_cells.size());
+    setThreads(_data);
+    Progress progress(_data, "Continuation", static_cast <uint64_t> (N));
+    #pragma omp parallel for schedule(dynamic)
+    for (int n = 0; n < N; ++n) {
+        History& h = _history[n];
+        const IntegratorOut prediction = predict(h, s, 0);
+        // the checked error belongs to a shorter extrapolation, the gap to the linear one grows with the distance
+        const double estimate = (h.n == 3) ? std::max(h.error, relativeError(predict(h, s, 1), prediction)) : 1;
+        const bool skip = (h.n == 3) && (estimate < _tolerance) && (h.nSkipped < _maxSkip);
+        h.computed = !skip;
+        if (skip) {
+            _iOuts[n] = prediction;
+            h.error = estimate;
+            ++h.nSkipped;
+        } else {
+            const ContinuationCell& c = _cells[n];
+            _iOuts[n] = integrateOverX(data, c.kxMin, c.kxMax, c.ky, c.kz);
+            if (h.n == 3) {
+                h.error = relativeError(prediction, _iOuts[n]);
+            }
+            h.nSkipped = 0;
+
+            if (h.n == 3) {
+                h.s[0] = h.s[1];
+                h.s[1] = h.s[2];
+                h.iOut[0] = h.iOut[1];
+                h.iOut[1] = h.iOut[2];
+            } else {
+                ++h.n;
+            }
+            h.s[h.n - 1] = s;
+            h.iOut[h.n - 1] = _iOuts[n];
+        }
+        progress.add();
+    }
+    return _iOuts;
+}
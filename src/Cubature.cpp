@@ -0,0 +1,228 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Cubature.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include <cmath>
+
+#include "include/Affinity.h"
+#include "include/integrator.h"
+#include "include/Parameters.h"
+
+namespace {
+
+// nodes are indexed on the grid of 2^maxLevel intervals along every axis, regions need their quarter points on it
+constexpr int maxLevel = 30;
+constexpr int maxRegionLevel = maxLevel - 2;
+
+typedef std::pair <int64_t, int64_t> Index;
+
+// region [iy, iy + 1] / 2^ly x [iz, iz + 1] / 2^lz of the unit square
+struct Region {
+ public:
+    int ly;
+    int lz;
+    int64_t iy;
+    int64_t iz;
+    IntegratorOut integral;
+    IntegratorOut error;
+    int axis;   // axis of the larger error, 0 for ky, 1 for kz
+};
+
+// index of the m-th quarter point of the interval i of the level
+inline int64_t quarter(int level, int64_t i, int m) {
+    return (4 * i + m) << (maxLevel - level - 2);
+}
+
+IntegratorOut absolute(IntegratorOut iOut) {
+    iOut.Ex   = std::abs(iOut.Ex);
+    iOut.Ix   = std::abs(iOut.Ix);
+    iOut.EInx = std::abs(iOut.EInx);
+    for (double& value : iOut.reduced) {
+        value = std::abs(value);
+    }
+    return iOut;
+}
+
+// maximal error of Ex, Ix and EInx relative to the integral
+double relative(const IntegratorOut& error, const IntegratorOut& integral) {
+    double result = 0;
+    const double errors[3]    = {error.Ex, error.Ix, error.EInx};
+    const double integrals[3] = {integral.Ex, integral.Ix, integral.EInx};
+    for (int i = 0; i < 3; ++i) {
+        if (std::abs(integrals[i]) > 0) {
+            result = std::max(result, std::abs(errors[i]) / std::abs(integrals[i]));
+        }
+    }
+    return result;
+}
+
+// Simpson rule with step width / 2 (coarse, odd nodes unused) and width / 4 (fine) on the 5 quarter points
+void weights(double width, bool fine, double w[5]) {
+    const double coarse[5]    = {1, 0, 4, 0, 1};
+    const double composite[5] = {1, 4, 2, 4, 1};
+    for (int m = 0; m < 5; ++m) {
+        w[m] = fine ? composite[m] * width / 12 : coarse[m] * width / 6;
+    }
+}
+
+// tensor Simpson rule over the region, fine or coarse along every axis
+IntegratorOut simpson(const Region& r, const std::map <Index, IntegratorOut>& values, double widthY, double widthZ,
+                      bool fineY, bool fineZ) {
+    double wy[5], wz[5];
+    weights(widthY, fineY, wy);
+    weights(widthZ, fineZ, wz);
+    IntegratorOut sum;
+    for (int m = 0; m < 5; ++m) {
+        for (int n = 0; n < 5; ++n) {
+            const double w = wy[m] * wz[n];
+            if (w > 0) {
+                sum += values.at(Index(quarter(r.ly, r.iy, m), quarter(r.lz, r.iz, n))) * w;
+            }
+        }
+    }
+    return sum;
+}
+
+void estimate(Region& r, const std::map <Index, IntegratorOut>& values, double widthY, double widthZ) {
+    const IntegratorOut fine    = simpson(r, values, widthY, widthZ, true,  true);
+    const IntegratorOut coarse  = simpson(r, values, widthY, widthZ, false, false);
+    const IntegratorOut coarseY = simpson(r, values, widthY, widthZ, false, true);
+    const IntegratorOut coarseZ = simpson(r, values, widthY, widthZ, true,  false);
+
+    // Simpson error is O(h^4), so the difference of the steps h and h / 2 is 15 errors of the fine rule
+    IntegratorOut difference = fine;
+    difference -= coarse;
+    difference *= 1.0 / 15;
+    r.integral = fine + difference;
+    r.error    = absolute(difference);
+
+    IntegratorOut errorY = fine;
+    errorY -= coarseY;
+    IntegratorOut errorZ = fine;
+    errorZ -= coarseZ;
+    r.axis = (relative(errorY, fine) >= relative(errorZ, fine)) ? 0 : 1;
+}
+
+}  // namespace
+
+CubatureOut cubature(const Parameters& data, const std::function <IntegratorOut(double ky, double kz)>& f,
+                     double kyMin, double kyMax, double kzMin, double kzMax, double tolerance) {
+    auto ky = [kyMin, kyMax](int64_t i) {
+        return kyMin + (kyMax - kyMin) * std::ldexp(static_cast <double> (i), -maxLevel);
+    };
+    auto kz = [kzMin, kzMax](int64_t i) {
+        return kzMin + (kzMax - kzMin) * std::ldexp(static_cast <double> (i), -maxLevel);
+    };
+
+    std::map <Index, IntegratorOut> values;
+    std::vector <Region> regions;
+    std::vector <Region> fresh;
+    for (int64_t iy = 0; iy < 2; ++iy) {
+        for (int64_t iz = 0; iz < 2; ++iz) {
+            fresh.push_back(Region{1, 1, iy, iz, IntegratorOut(), IntegratorOut(), 0});
+        }
+    }
+
+    setThreads(data);
+    IntegratorOut integral;
+    while (!fresh.empty()) {
+        std::set <Index> missing;
+        for (const Region& r : fresh) {
+            for (int m = 0; m < 5; ++m) {
+                for (int n = 0; n < 5; ++n) {
+                    const Index index(quarter(r.ly, r.iy, m), quarter(r.lz, r.iz, n));
+                    if (values.count(index) == 0) {
+                        missing.insert(index);
+                    }
+                }
+            }
+        }
+
+        const std::vector <Index> nodes(missing.begin(), missing.end());
+        const int N = static_cast <int> (nodes.size());
+        std::vector <IntegratorOut> iOuts(N);
+        #pragma omp parallel for schedule(dynamic)
+        for (int n = 0; n < N; ++n) {
+            iOuts[n] = f(ky(nodes[n].first), kz(nodes[n].second));
+        }
+        for (int n = 0; n < N; ++n) {
+            values[nodes[n]] = iOuts[n];
+        }
+
+        for (Region& r : fresh) {
+            estimate(r, values, std::ldexp(kyMax - kyMin, -r.ly), std::ldexp(kzMax - kzMin, -r.lz));
+            regions.push_back(r);
+        }
+        fresh.clear();
+
+        integral = IntegratorOut();
+        for (const Region& r : regions) {
+            integral += r.integral;
+        }
+        double error = 0;
+        for (const Region& r : regions) {
+            error += relative(r.error, integral);
+        }
+        if (data.progress > 0) {
+            fprintf(stderr, "Cubature: %zu nodes, %zu regions, relative error %.3le\n", values.size(), regions.size(),
+                    error);
+        }
+        if (error <= tolerance) {
+            break;
+        }
+
+        // regions with the smallest errors are kept while their sum is below tolerance / 2, the others are bisected
+        std::sort(regions.begin(), regions.end(), [&integral](const Region& a, const Region& b) {
+            return relative(a.error, integral) < relative(b.error, integral);
+        });
+        std::vector <Region> kept;
+        double keptError = 0;
+        for (const Region& r : regions) {
+            const double e = relative(r.error, integral);
+            int axis = r.axis;
+            if ((axis == 0) && (r.ly >= maxRegionLevel)) {
+                axis = 1;
+            } else if ((axis == 1) && (r.lz >= maxRegionLevel)) {
+                axis = 0;
+            }
+            const bool splittable = (axis == 0) ? (r.ly < maxRegionLevel) : (r.lz < maxRegionLevel);
+            if ((keptError + e <= 0.5 * tolerance) || !splittable) {
+                keptError += e;
+                kept.push_back(r);
+            } else if (axis == 0) {
+                fresh.push_back(Region{r.ly + 1, r.lz, 2 * r.iy,     r.iz, IntegratorOut(), IntegratorOut(), 0});
+                fresh.push_back(Region{r.ly + 1, r.lz, 2 * r.iy + 1, r.iz, IntegratorOut(), IntegratorOut(), 0});
+            } else {
+                fresh.push_back(Region{r.ly, r.lz + 1, r.iy, 2 * r.iz,     IntegratorOut(), IntegratorOut(), 0});
+                fresh.push_back(Region{r.ly, r.lz + 1, r.iy, 2 * r.iz + 1, IntegratorOut(), IntegratorOut(), 0});
+            }
+        }
+        regions = kept;
+    }
+
+    CubatureOut out;
+    out.integral = integral;
+    for (const Region& r : regions) {
+        out.error += r.error;
+    }
+    for (const auto& value : values) {
+        out.nodes.push_back(CubatureNode{ky(value.first.first), kz(value.first.second), value.second});
+    }
+    return out;
+}
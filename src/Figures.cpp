@@ -0,0 +1,217 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Figures.h"
+
+#include <omp.h>
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cmath>
+
+#include <boost/format.hpp>
+
+#include "include/Affinity.h"
+#include "include/integrator.h"
+#include "include/maps.h"
+#include "include/Parameters.h"
+#include "include/Progress.h"
+#include "include/Reducers.h"
+#include "include/WaveVector.h"
+
+void solutionMapKxKy(const Parameters& data, const CellEvaluator& evaluate, bool output) {
+    const double kz    = 0;
+
+    const double dk    = 0.02;
+    const double kyMin = dk;
+    const double kyMax =  3;
+    const double kxMin = -20;
+    const double kxMax =  20;
+
+    std::stringstream mapName;
+    mapName << boost::format("./map/Map(kx,ky) R = %.0le R_b = %.0le dk = %.2lf kz = %.1lf") \
+        % (1.0 / data.invRe) % (1.0 / data.invRe_b) % dk % kz;
+    std::ofstream fOut;
+    if (output) {
+        fOut.open(mapName.str());
+    }
+
+    mapKxKy(data, fOut, dk, kxMin, kxMax, kyMin, kyMax, kz, evaluate);
+}
+
+void solutionMapKxKz(const Parameters& data, const CellEvaluator& evaluate, bool output) {
+    const double ky    =  0.75;
+
+    const double dk    =  0.02;
+    const double kzMin =  0;
+    const double kzMax =  4;
+    const double kxMin = -30;
+    const double kxMax =  30;
+
+    std::stringstream mapName;
+    mapName << boost::format("./map/Map(kx,kz) R = %.0le R_b = %.0le dk = %.2lf ky = %.2lf") \
+        % (1.0 / data.invRe) % (1.0 / data.invRe_b) % dk % ky;
+    std::ofstream fOut;
+    if (output) {
+        fOut.open(mapName.str());
+    }
+
+    mapKxKz(data, fOut, dk, kxMin, kxMax, kzMin, kzMax, ky, evaluate);
+}
+
+void solutionMapKyKz(const Parameters& data, const CellEvaluator& evaluate, bool output) {
+    const double dk    =  0.02;
+
+    const double kyMin =  dk;
+    const double kyMax =  4;
+
+    const double kzMin =  0;
+    const double kzMax =  4;
+
+    std::stringstream mapName;
+    mapName << boost::format("./map/Map(ky,kz) R = %.0le R_b = %.0le dk = %.2lf kx = optimal") \
+        % (1.0 / data.invRe) % (1.0 / data.invRe_b) % dk;
+    std::ofstream fOut;
+    if (output) {
+        fOut.open(mapName.str());
+    }
+
+    mapKyKz(data, fOut, dk, kyMin, kyMax, kzMin, kzMax, evaluate);
+}
+
+void solutionRelativeMapKyKz(const Parameters& data, const CellEvaluator& evaluate, bool output) {
+    const double dk    =  0.02;
+
+    const double kyMin =  dk;
+    const double kyMax =  4;
+
+    const double kzMin =  0;
+    const double kzMax =  4;
+
+    std::stringstream mapName;
+    mapName << boost::format("./map/RelMap(ky,kz) R = %.0le R_b = %.0le dk = %.3lf kx = optimal") \
+        % (1.0 / data.invRe) % (1.0 / data.invRe_b) % dk;
+    std::ofstream fOut;
+    if (output) {
+        fOut.open(mapName.str());
+    }
+
+    relativeMapKyKz(data, fOut, dk, kyMin, kyMax, kzMin, kzMax, evaluate);
+}
+
+void optimalR(const Parameters& data, const CellEvaluator& evaluate, bool output) {
+    const double ky        =  1.0;
+    const double kz        =  0.0;
+    const double kx        = -pow(data.q * ky / data.invRe, 1.0 / 3.0);
+
+    const double dk    =  0.005;
+
+    std::stringstream name;
+    name << boost::format("E(R) R_b = %.0le ky = %.2lf kz = %.2lf dk = %.3lf") \
+                                                                        % (1.0 / data.invRe_b) % (ky) % (kz) % dk;
+    std::ofstream fOut;
+    if (output) {
+        fOut.open(name.str(), std::ios_base::app);
+    }
+
+    IntegratorOut error;
+    IntegratorOut iOut = evaluate(data, kx, kx + dk, ky, kz, error, nullptr);
+    data.outputTuning(fOut);
+    outputReducedColumns(data, fOut);
+    fOut << 1.0 / data.invRe << "\t" \
+         << iOut.Ex          << "\t" \
+         << iOut.Ix          << "\t" \
+         << iOut.EInx;
+    outputReduced(fOut, iOut);
+    fOut << "\n";
+}
+
+void spectraKyKz(const Parameters& data, const CellEvaluator& evaluate, bool output) {
+    const double kxMax  = 5;
+    const double kyMax  = 2;
+    const double kzMax  = 2;
+
+    const double dky = 0.1;
+    const double dkz = 0.1;
+
+    integrate(data, WaveVector(data, kxMax, kyMax, kzMax), dky, dkz, evaluate, output);
+}
+
+const std::map <std::string, Figure>& figures() {
+    static const std::map <std::string, Figure> figures = {
+        {"solutionMap[kx,ky]",         solutionMapKxKy},
+        {"solutionMap[kx,kz]",         solutionMapKxKz},
+        {"solutionMap[ky,kz]",         solutionMapKyKz},
+        {"solutionRelativeMap[ky,kz]", solutionRelativeMapKyKz},
+        {"optimal[R]",                 optimalR},
+        {"spectra[ky,kz]",             spectraKyKz}};
+    return figures;
+}
+
+CellPool::Key CellPool::key(const Parameters& data, double kxMin, double kxMax, double ky, double kz) {
+    return Key(data.invRe, data.invRe_b, data.Ct, data.richardson, kxMin, kxMax, ky, kz);
+}
+
+CellPool::Cell CellPool::integrate(const Parameters& data, const Key& k) {
+    const Parameters cellData = data.withInvRe(std::get <0> (k), std::get <1> (k)).withCt(std::get <2> (k));
+    Cell cell{IntegratorOut(), IntegratorOut()};
+    cell.iOut = extrapolateOverX(cellData, std::get <4> (k), std::get <5> (k), std::get <6> (k), std::get <7> (k),
+                                 Forcing::Flat, std::get <3> (k), cell.error);
+    return cell;
+}
+
+IntegratorOut CellPool::record(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                               IntegratorOut& error, CellCounters*) {
+    std::lock_guard <std::mutex> lock(_mutex);
+    _cells.emplace(key(data, kxMin, kxMax, ky, kz), Cell{IntegratorOut(), IntegratorOut()});
+    ++_requested;
+    error = IntegratorOut();
+    return IntegratorOut();
+}
+
+void CellPool::run(const Parameters& data) {
+    std::vector <std::pair <const Key, Cell>*> cells;
+    for (auto& cell : _cells) {
+        cells.push_back(&cell);
+    }
+
+    const int N = static_cast <int> (cells.size());
+    setThreads(data);
+    Progress progress(data, "Cells", static_cast <uint64_t> (N));
+    #pragma omp parallel for schedule(dynamic)
+    for (int n = 0; n < N; ++n) {
+        cells[n]->second = integrate(data, cells[n]->first);
+        progress.add();
+    }
+}
+
+IntegratorOut CellPool::lookup(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                               IntegratorOut& error, CellCounters*) {
+    const Key k = key(data, kxMin, kxMax, ky, kz);
+    {
+        std::lock_guard <std::mutex> lock(_mutex);
+        const auto cell = _cells.find(k);
+        if (cell != _cells.end()) {
+            error = cell->second.error;
+            return cell->second.iOut;
+        }
+    }
+
+    // the adaptive cubature of Spectra(ky, kz) refines by the values of its nodes, so it asks for nodes its record
+    // pass did not reach, they are integrated by the threads of the cubature and kept for the next figures
+    const Cell cell = integrate(data, k);
+    std::lock_guard <std::mutex> lock(_mutex);
+    _cells.emplace(k, cell);
+    error = cell.error;
+    return cell.iOut;
+}
@@ -0,0 +1,140 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Kernels.h"
+
+#include <stdexcept>
+#include <string>
+
+#include "include/Parameters.h"
+
+namespace {
+
+/* Bodies of the kernels. They are forced inline into the variants below, which are compiled with different target
+   attributes, so every variant gets its own copy vectorized for its instruction set. Plain inline is not enough:
+   the bodies are used four times and GCC would keep a single out-of-line copy compiled for the baseline. */
+
+#define DOKFUSF_BODY inline __attribute__((always_inline))
+
+DOKFUSF_BODY void lyapunovRhsBody(const double* A, const double* C, const double* Q, double* dCdt) {
+    double AC[16] = {};
+    for (int i = 0; i < 4; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            for (int j = 0; j < 4; ++j) {
+                AC[4 * i + j] += A[4 * i + k] * C[4 * k + j];
+            }
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            dCdt[4 * i + j] = Q[4 * i + j] + AC[4 * i + j] + AC[4 * j + i];
+        }
+    }
+}
+
+DOKFUSF_BODY void multiplyBody(int n, const double* a, const double* b, double* c) {
+    for (int i = 0; i < n * n; ++i) {
+        c[i] = 0;
+    }
+    for (int i = 0; i < n; ++i) {
+        for (int k = 0; k < n; ++k) {
+            const double aik = a[n * i + k];
+            for (int j = 0; j < n; ++j) {
+                c[n * i + j] += aik * b[n * k + j];
+            }
+        }
+    }
+}
+
+DOKFUSF_BODY double ensembleStepBody(size_t n, const double* phi, const double* g, const double* dW, size_t stride,
+                                     double* u0, double* u1, double* u2, double* u3, double* Ex, double* Ix,
+                                     double dkx) {
+    const double* dW0 = dW;
+    const double* dW1 = dW + stride;
+    const double* dW2 = dW + 2 * stride;
+    const double* dW3 = dW + 3 * stride;
+    double sum = 0;
+    #pragma omp simd reduction(+:sum)
+    for (size_t m = 0; m < n; ++m) {
+        const double u[4]  = {u0[m], u1[m], u2[m], u3[m]};
+        double uNew[4];
+        for (int i = 0; i < 4; ++i) {
+            uNew[i] = phi[4 * i] * u[0]   + phi[4 * i + 1] * u[1]   + phi[4 * i + 2] * u[2]   + phi[4 * i + 3] * u[3] +
+                      g[4 * i]   * dW0[m] + g[4 * i + 1]   * dW1[m] + g[4 * i + 2]   * dW2[m] + g[4 * i + 3]   * dW3[m];
+        }
+        const double E0 = u[0] * u[0] + u[1] * u[1] + u[2] * u[2] + u[3] * u[3];
+        const double E1 = uNew[0] * uNew[0] + uNew[1] * uNew[1] + uNew[2] * uNew[2] + uNew[3] * uNew[3];
+        Ex[m] += (E0 + E1) * 0.5 * dkx;
+        Ix[m] += (u[0] * u[1] + uNew[0] * uNew[1]) * 0.5 * dkx;
+        u0[m] = uNew[0];
+        u1[m] = uNew[1];
+        u2[m] = uNew[2];
+        u3[m] = uNew[3];
+        sum += E1;
+    }
+    return sum;
+}
+
+#define DOKFUSF_KERNELS(variant, attribute)                                                                            \
+    attribute void lyapunovRhs##variant(const double* A, const double* C, const double* Q, double* dCdt) {            \
+        lyapunovRhsBody(A, C, Q, dCdt);                                                                                \
+    }                                                                                                                  \
+    attribute void multiply##variant(int n, const double* a, const double* b, double* c) {                            \
+        multiplyBody(n, a, b, c);                                                                                      \
+    }                                                                                                                  \
+    attribute double ensembleStep##variant(size_t n, const double* phi, const double* g, const double* dW,            \
+                                           size_t stride, double* u0, double* u1, double* u2, double* u3,             \
+                                           double* Ex, double* Ix, double dkx) {                                       \
+        return ensembleStepBody(n, phi, g, dW, stride, u0, u1, u2, u3, Ex, Ix, dkx);                                   \
+    }
+
+DOKFUSF_KERNELS(Generic, )
+DOKFUSF_KERNELS(Sse42,   __attribute__((target("sse4.2"))))
+DOKFUSF_KERNELS(Avx2,    __attribute__((target("avx2,fma"))))
+DOKFUSF_KERNELS(Avx512,  __attribute__((target("avx512f,avx512dq,avx2,fma"))))
+
+#undef DOKFUSF_KERNELS
+#undef DOKFUSF_BODY
+
+const Kernels generic = {Isa::Generic, lyapunovRhsGeneric, multiplyGeneric, ensembleStepGeneric};
+const Kernels sse42   = {Isa::Sse42,   lyapunovRhsSse42,   multiplySse42,   ensembleStepSse42};
+const Kernels avx2    = {Isa::Avx2,    lyapunovRhsAvx2,    multiplyAvx2,    ensembleStepAvx2};
+const Kernels avx512  = {Isa::Avx512,  lyapunovRhsAvx512,  multiplyAvx512,  ensembleStepAvx512};
+
+bool supported(Isa isa) {
+    __builtin_cpu_init();
+    switch (isa) {
+        case Isa::Auto:
+        case Isa::Generic: return true;
+        case Isa::Sse42:   return __builtin_cpu_supports("sse4.2");
+        case Isa::Avx2:    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case Isa::Avx512:  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+    }
+    return false;
+}
+
+}  // namespace
+
+const Kernels& kernels(Isa isa) {
+    if (isa == Isa::Auto) {
+        static const Kernels& best = supported(Isa::Avx512) ? avx512 :
+                                     supported(Isa::Avx2)   ? avx2   :
+                                     supported(Isa::Sse42)  ? sse42  : generic;
+        return best;
+    }
+    if (!supported(isa)) {
+        throw std::runtime_error("Instruction set " + isaName(isa) + " is not supported by this CPU");
+    }
+    switch (isa) {
+        case Isa::Sse42:  return sse42;
+        case Isa::Avx2:   return avx2;
+        case Isa::Avx512: return avx512;
+        default:          return generic;
+    }
+}
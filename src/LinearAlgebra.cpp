@@ -0,0 +1,93 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/LinearAlgebra.h"
+
+#include <algorithm>
+#include <vector>
+#include <cmath>
+
+#include <boost/numeric/ublas/matrix.hpp>
+
+#include "include/LyapunovEquations.h"
+
+void symmetricEigen(const Matrix& S, std::vector <double>& values, Matrix& vectors) {
+    const size_t N = S.size1();
+    Matrix M = S;
+    vectors = ublas::identity_matrix <double> (N);
+
+    const int nSweepsMax = 50;
+    for (int sweep = 0; sweep < nSweepsMax; ++sweep) {
+        double offDiagonal = 0;
+        double diagonal = 0;
+        for (size_t i = 0; i < N; ++i) {
+            diagonal += M(i, i) * M(i, i);
+            for (size_t j = i + 1; j < N; ++j) {
+                offDiagonal += M(i, j) * M(i, j);
+            }
+        }
+        if (offDiagonal <= 1e-30 * diagonal || offDiagonal < 1e-300) {
+            break;
+        }
+
+        for (size_t p = 0; p < N; ++p) {
+            for (size_t q = p + 1; q < N; ++q) {
+                if (std::abs(M(p, q)) < 1e-300) {
+                    continue;
+                }
+                // rotation in (p, q) plane which zeroes M(p, q)
+                const double theta = (M(q, q) - M(p, p)) / (2 * M(p, q));
+                const double t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                const double c = 1 / std::sqrt(t * t + 1);
+                const double s = t * c;
+                for (size_t k = 0; k < N; ++k) {
+                    const double Mkp = M(k, p);
+                    const double Mkq = M(k, q);
+                    M(k, p) = c * Mkp - s * Mkq;
+                    M(k, q) = s * Mkp + c * Mkq;
+                }
+                for (size_t k = 0; k < N; ++k) {
+                    const double Mpk = M(p, k);
+                    const double Mqk = M(q, k);
+                    M(p, k) = c * Mpk - s * Mqk;
+                    M(q, k) = s * Mpk + c * Mqk;
+                }
+                for (size_t k = 0; k < N; ++k) {
+                    const double Vkp = vectors(k, p);
+                    const double Vkq = vectors(k, q);
+                    vectors(k, p) = c * Vkp - s * Vkq;
+                    vectors(k, q) = s * Vkp + c * Vkq;
+                }
+            }
+        }
+    }
+
+    values.resize(N);
+    for (size_t i = 0; i < N; ++i) {
+        values[i] = M(i, i);
+    }
+}
+
+Matrix symmetricSqrt(const Matrix& S) {
+    std::vector <double> values;
+    Matrix vectors;
+    symmetricEigen(S, values, vectors);
+
+    const size_t N = S.size1();
+    Matrix root = ZeroMatrix(N, N);
+    for (size_t n = 0; n < N; ++n) {
+        const double lambda = std::sqrt(std::max(values[n], 0.0));
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                root(i, j) += vectors(i, n) * lambda * vectors(j, n);
+            }
+        }
+    }
+    return root;
+}
@@ -10,6 +10,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 #include "include/LyapunovEquations.h"
 
 #include <algorithm>
+#include <array>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <cmath>
 
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/odeint/integrate/integrate.hpp>
@@ -17,73 +22,281 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
 namespace ode = boost::numeric::odeint;
 
-Matrix AbstractLyapunovEquation::A(double t) const {
-    Matrix M = ZeroMatrix(4, 4);
+typedef ode::controlled_runge_kutta <ode::runge_kutta_dopri5 <Matrix, double, Matrix, double>> ControlledStepper;
+
+// controlled steps of stepper from t0 to t1, accepted and rejected steps are added to counters unless it is nullptr
+template <class Equation, class Stepper>
+void advanceControlled(const Equation& eq, Stepper stepper, Matrix& C, double t0, double t1, double dt,
+                       PhaseCounters* counters) {
+    ode::failed_step_checker fail_checker;
+    while (ode::detail::less_with_sign(t0, t1, dt)) {
+        if (ode::detail::less_with_sign(t1, t0 + dt, dt)) {
+            dt = t1 - t0;
+        }
+        ode::controlled_step_result res;
+        do {
+            res = stepper.try_step(eq, C, t0, dt);
+            if ((res == ode::fail) && (counters != nullptr)) {
+                ++counters->rejected;
+            }
+            fail_checker();
+        } while (res == ode::fail);
+        fail_checker.reset();
+        if (counters != nullptr) {
+            ++counters->accepted;
+        }
+    }
+    if (counters != nullptr) {
+        ++counters->steps;
+    }
+}
 
-//             non-viscous  viscosity                bulk viscosity
-    M(x, x) =              -norm(_k(t)) * _invRe -_k.x(t) * _k.x(t) * _invRe_b;
-    M(x, y) =  2                                 -_k.y()  * _k.x(t) * _invRe_b;
-    M(x, z) =                                    -_k.z()  * _k.x(t) * _invRe_b;
-    M(x, w) =  _k.x(t);
-
-    M(y, x) = -(2 - _q)                          -_k.x(t) * _k.y()  * _invRe_b;
-    M(y, y) =              -norm(_k(t)) * _invRe -_k.y()  * _k.y()  * _invRe_b;
-    M(y, z) =                                    -_k.z()  * _k.y()  * _invRe_b;
-    M(y, w) =  _k.y();
-
-    M(z, x) =                                    -_k.x(t) * _k.z()  * _invRe_b;
-    M(z, y) =                                    -_k.y()  * _k.z()  * _invRe_b;
-    M(z, z) =              -norm(_k(t)) * _invRe -_k.z()  * _k.z()  * _invRe_b;
-    M(z, w) =  _k.z();
-
-    M(w, x) = -_k.x(t);
-    M(w, y) = -_k.y();
-    M(w, z) = -_k.z();
-    M(w, w) =  0;
-    return M;
+// the same as ode::integrate(eq, C, t0, t1, dt), but accepted and rejected steps are added to counters
+template <class Equation>
+void advance(const Equation& eq, Matrix& C, double t0, double t1, double dt, PhaseCounters* counters) {
+    if (counters == nullptr) {
+        ode::integrate(eq, C, t0, t1, dt);
+        return;
+    }
+    advanceControlled(eq, ControlledStepper(), C, t0, t1, dt, counters);
 }
 
-Matrix AbstractLyapunovEquation::Adag(double t) const {
-    Matrix M = ZeroMatrix(4, 4);
+/* The same error measure as ode::default_error_checker, but over the leading 4 x 4 block only. The derivatives of
+   TangentLinearEquation follow the steps chosen for C instead of refining them. */
+class LeadingBlockErrorChecker {
+ public:
+    template <class Algebra>
+    double error(Algebra&, const Matrix& x_old, const Matrix& dxdt_old, const Matrix& x_err, double dt) const {
+        constexpr double eps_abs = 1e-6;
+        constexpr double eps_rel = 1e-6;
+        double result = 0;
+        for (size_t i = 0; i < 16; ++i) {
+            const double scale = eps_abs + eps_rel * (std::abs(x_old.data()[i]) + std::abs(dt * dxdt_old.data()[i]));
+            result = std::max(result, std::abs(x_err.data()[i]) / scale);
+        }
+        return result;
+    }
+};
+
+typedef ode::controlled_runge_kutta <ode::runge_kutta_dopri5 <Matrix, double, Matrix, double>,
+                                     LeadingBlockErrorChecker> TangentStepper;
+
+// the same as advance(), but the state is observed at multiples of dtOut by dense output instead of step ends
+template <class Equation>
+bool sampleDense(const Equation& eq, Matrix& C, double& t, double tMax, double dtOut, const Observer& observer,
+                 PhaseCounters* counters) {
+    if (t >= tMax) {
+        return true;
+    }
+    Equation system(eq);
+    auto stepper = ode::make_dense_output(1e-6, 1e-6, ode::runge_kutta_dopri5 <Matrix, double, Matrix, double>());
+    stepper.initialize(C, t, std::min(eq.get_dt(t), tMax - t));
+
+    const double eps = 1e-9 * dtOut;
+    double n = std::floor((t + eps) / dtOut) + 1;
+    bool reached = false;
+    while (reached == false) {
+        if (stepper.current_time() + stepper.current_time_step() > tMax) {
+            stepper.initialize(stepper.current_state(), stepper.current_time(), tMax - stepper.current_time());
+        }
+        stepper.do_step(std::ref(system));
+        if (counters != nullptr) {
+            ++counters->accepted;
+        }
+        reached = (tMax - stepper.current_time() <= eps);
+
+        while ((n * dtOut <= stepper.current_time() + eps) && (n * dtOut <= tMax + eps)) {
+            t = std::min(n * dtOut, tMax);
+            stepper.calc_state(t, C);
+            n += 1;
+            if (observer(t, C) == false) {
+                if (counters != nullptr) {
+                    ++counters->steps;
+                }
+                return false;
+            }
+        }
+    }
+    C = stepper.current_state();
+    t = tMax;
+    if (counters != nullptr) {
+        ++counters->steps;
+    }
+    return true;
+}
+
+Matrix solveLyapunov(const Matrix& A, const Matrix& Q) {
+    constexpr int N = 4;
+    constexpr int M = N * (N + 1) / 2;
+
+    // index of unknown C(i, j) = C(j, i)
+    int index[N][N];
+    for (int i = 0, n = 0; i < N; ++i) {
+        for (int j = i; j < N; ++j, ++n) {
+            index[i][j] = n;
+            index[j][i] = n;
+        }
+    }
+
+    // (A C + C A^T)(i, j) = sum_k A(i, k) C(k, j) + A(j, k) C(i, k) for i <= j
+    double L[M][M + 1] = {};
+    double scale = 0;
+    for (int i = 0; i < N; ++i) {
+        for (int j = i; j < N; ++j) {
+            const int row = index[i][j];
+            for (int k = 0; k < N; ++k) {
+                L[row][index[k][j]] += A(i, k);
+                L[row][index[i][k]] += A(j, k);
+            }
+            L[row][M] = -Q(i, j);
+        }
+    }
+    for (int row = 0; row < M; ++row) {
+        for (int col = 0; col < M; ++col) {
+            scale = std::max(scale, std::abs(L[row][col]));
+        }
+    }
+
+    // elimination with partial pivoting
+    for (int col = 0; col < M; ++col) {
+        int pivot = col;
+        for (int row = col + 1; row < M; ++row) {
+            if (std::abs(L[row][col]) > std::abs(L[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (std::abs(L[pivot][col]) <= 1e-13 * scale) {
+            throw std::runtime_error("solveLyapunov: steady state does not exist for given A");
+        }
+        if (pivot != col) {
+            for (int n = col; n <= M; ++n) {
+                std::swap(L[pivot][n], L[col][n]);
+            }
+        }
+        for (int row = col + 1; row < M; ++row) {
+            const double factor = L[row][col] / L[col][col];
+            for (int n = col; n <= M; ++n) {
+                L[row][n] -= factor * L[col][n];
+            }
+        }
+    }
+
+    double c[M];
+    for (int row = M - 1; row >= 0; --row) {
+        double sum = L[row][M];
+        for (int n = row + 1; n < M; ++n) {
+            sum -= L[row][n] * c[n];
+        }
+        c[row] = sum / L[row][row];
+    }
+
+    Matrix C(N, N);
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            C(i, j) = c[index[i][j]];
+        }
+    }
+    return C;
+}
+
+Regime AbstractLyapunovEquation::regime(const Parameters& data) {
+    if (data.invRe_b > 0) {
+        return Regime::BulkViscous;
+    }
+    return (data.invRe > 0) ? Regime::Viscous : Regime::Inviscid;
+}
+
+template <Regime regime>
+void AbstractLyapunovEquation::fillA(double a[4][4], double t) const {
+    const double k[3] = {_k.x(t), _k.y(), _k.z()};
+
+//                non-viscous
+    a[x][x] =  0;         a[x][y] =  2;     a[x][z] =  0;     a[x][w] =  k[x];
+    a[y][x] = -(2 - _q);  a[y][y] =  0;     a[y][z] =  0;     a[y][w] =  k[y];
+    a[z][x] =  0;         a[z][y] =  0;     a[z][z] =  0;     a[z][w] =  k[z];
+    a[w][x] = -k[x];      a[w][y] = -k[y];  a[w][z] = -k[z];  a[w][w] =  0;
+
+    if (regime != Regime::Inviscid) {
+        // viscosity and bulk viscosity, the latter includes 1 / (3 R) even for R_b = inf
+        const double nu = (k[x] * k[x] + k[y] * k[y] + k[z] * k[z]) * _invRe;
+        for (int i = 0; i < 3; ++i) {
+            a[i][i] -= nu;
+            for (int j = 0; j < 3; ++j) {
+                a[i][j] -= k[i] * k[j] * _invRe_b;
+            }
+        }
+    }
+}
+
+template <Regime regime>
+double AbstractLyapunovEquation::dt(double t) const {
+    const double k2 = norm(_k(t));
+    const double stepSound = _Ct / std::sqrt(k2);
+    switch (regime) {
+        case Regime::Inviscid:
+            return stepSound;
+        case Regime::Viscous:
+            // 1 / (3 R) < 1 / R, so the bulk viscosity never limits the step
+            return std::min(stepSound, _Ct / (_invRe * k2));
+        case Regime::BulkViscous:
+            if (_invRe > 0) {
+                double stepRe    = _Ct / (_invRe   * k2);
+                double stepRe_b  = _Ct / (_invRe_b * k2);
+
+                double step = std::min(stepSound, stepRe);
+                return std::min(step, stepRe_b);
+            }
+            return stepSound;
+    }
+    return stepSound;
+}
+
+template <Regime regime>
+void AbstractLyapunovEquation::rhs(const Matrix& C, Matrix& dCdt, double t) const {
+    double a[4][4];
+    fillA <regime> (a, t);
 
-//             non-viscous  viscosity               bulk viscosity
-    M(x, x) =              -norm(_k(t)) * _invRe -_k.x(t) * _k.x(t) * _invRe_b;
-    M(x, y) = -(2 - _q)                          -_k.y()  * _k.x(t) * _invRe_b;
-    M(x, z) =                                    -_k.z()  * _k.x(t) * _invRe_b;
-    M(x, w) =  -_k.x(t);
-
-    M(y, x) =  2                                 -_k.x(t) * _k.y()  * _invRe_b;
-    M(y, y) =              -norm(_k(t)) * _invRe -_k.y()  * _k.y()  * _invRe_b;
-    M(y, z) =                                    -_k.z()  * _k.y()  * _invRe_b;
-    M(y, w) =  -_k.y();
-
-    M(z, x) =                                    -_k.x(t) * _k.z()  * _invRe_b;
-    M(z, y) =                                    -_k.y()  * _k.z()  * _invRe_b;
-    M(z, z) =              -norm(_k(t)) * _invRe -_k.z()  * _k.z()  * _invRe_b;
-    M(z, w) =  -_k.z();
-
-    M(w, x) =  _k.x(t);
-    M(w, y) =  _k.y();
-    M(w, z) =  _k.z();
-    M(w, w) =  0;
+    // C is symmetric, so C A^T = (A C)^T
+    const Matrix Q = FFdag(t);
+    dCdt.resize(4, 4, false);
+    _kernels.lyapunovRhs(&a[0][0], &C.data()[0], &Q.data()[0], &dCdt.data()[0]);
+}
+
+Matrix AbstractLyapunovEquation::A(double t) const {
+    double a[4][4];
+    switch (_regime) {
+        case Regime::Inviscid:    fillA <Regime::Inviscid>    (a, t); break;
+        case Regime::Viscous:     fillA <Regime::Viscous>     (a, t); break;
+        case Regime::BulkViscous: fillA <Regime::BulkViscous> (a, t); break;
+    }
+
+    Matrix M(4, 4);
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            M(i, j) = a[i][j];
+        }
+    }
     return M;
 }
 
 double AbstractLyapunovEquation::get_dt(double t) const {
-    double stepSound = _Ct / abs(_k(t));
-    if (_invRe > 0) {
-        double stepRe    = _Ct / (_invRe   * norm(_k(t)));
-        double stepRe_b  = _Ct / (_invRe_b * norm(_k(t)));
-
-        double step = std::min(stepSound, stepRe);
-        return std::min(step, stepRe_b);
-    } else {
-        return stepSound;
+    switch (_regime) {
+        case Regime::Inviscid:    return dt <Regime::Inviscid>    (t);
+        case Regime::Viscous:     return dt <Regime::Viscous>     (t);
+        case Regime::BulkViscous: return dt <Regime::BulkViscous> (t);
     }
+    return dt <Regime::BulkViscous> (t);
 }
 
 void AbstractLyapunovEquation::operator ()(const Matrix& C, Matrix& dCdt, double t) {
-    dCdt = FFdag(t) + ublas::prod(A(t), C) + ublas::prod(C, Adag(t));
+    if (_counters != nullptr) {
+        ++_counters->rhs;
+    }
+    switch (_regime) {
+        case Regime::Inviscid:    rhs <Regime::Inviscid>    (C, dCdt, t); break;
+        case Regime::Viscous:     rhs <Regime::Viscous>     (C, dCdt, t); break;
+        case Regime::BulkViscous: rhs <Regime::BulkViscous> (C, dCdt, t); break;
+    }
 }
 
 Matrix LyapunovEquationWithFlatForcing::FFdag(double) const {
@@ -97,23 +310,28 @@ Matrix LyapunovEquationWithFlatForcing::FFdag(double) const {
 
 void LyapunovEquationWithFlatForcing::make_step_forward(Matrix &C, double& t) const {
     double dt = get_dt(t);
-    ode::integrate(*this, C, t, t + dt, dt);
+    advance(*this, C, t, t + dt, dt, _counters);
     t += dt;
 }
 
 bool LyapunovEquationWithFlatForcing::make_step_forward(Matrix &C, double& t, double tMax) const {
     double dt = get_dt(t);
     if (t + dt < tMax) {
-        ode::integrate(*this, C, t, t + dt, dt);
+        advance(*this, C, t, t + dt, dt, _counters);
         t += dt;
         return false;
     } else {
-        ode::integrate(*this, C, t, tMax, dt);
+        advance(*this, C, t, tMax, dt, _counters);
         t = tMax;
         return true;
     }
 }
 
+bool LyapunovEquationWithFlatForcing::sample(Matrix &C, double& t, double tMax, double dtOut,
+                                             const Observer& observer) const {
+    return sampleDense(*this, C, t, tMax, dtOut, observer, _counters);
+}
+
 Matrix LyapunovEquationWith2DFlatForcing::FFdag(double) const {
     Matrix M = ZeroMatrix(4, 4);
     M(x, x) = 0.5;
@@ -123,10 +341,28 @@ Matrix LyapunovEquationWith2DFlatForcing::FFdag(double) const {
 
 void LyapunovEquationWith2DFlatForcing::make_step_forward(Matrix &C, double& t) const {
     double dt = get_dt(t);
-    ode::integrate(*this, C, t, t + dt, dt);
+    advance(*this, C, t, t + dt, dt, _counters);
     t += dt;
 }
 
+bool LyapunovEquationWith2DFlatForcing::make_step_forward(Matrix &C, double& t, double tMax) const {
+    double dt = get_dt(t);
+    if (t + dt < tMax) {
+        advance(*this, C, t, t + dt, dt, _counters);
+        t += dt;
+        return false;
+    } else {
+        advance(*this, C, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool LyapunovEquationWith2DFlatForcing::sample(Matrix &C, double& t, double tMax, double dtOut,
+                                               const Observer& observer) const {
+    return sampleDense(*this, C, t, tMax, dtOut, observer, _counters);
+}
+
 Matrix LyapunovEquationWith2DWhiteForcing::FFdag(double t) const {
     Matrix M = ZeroMatrix(4, 4);
     M(x, x) = 1 / abs2D(_k(t));
@@ -137,10 +373,28 @@ Matrix LyapunovEquationWith2DWhiteForcing::FFdag(double t) const {
 
 void LyapunovEquationWith2DWhiteForcing::make_step_forward(Matrix &C, double& t) const {
     double dt = get_dt(t);
-    ode::integrate(*this, C, t, t + dt, dt);
+    advance(*this, C, t, t + dt, dt, _counters);
     t += dt;
 }
 
+bool LyapunovEquationWith2DWhiteForcing::make_step_forward(Matrix &C, double& t, double tMax) const {
+    double dt = get_dt(t);
+    if (t + dt < tMax) {
+        advance(*this, C, t, t + dt, dt, _counters);
+        t += dt;
+        return false;
+    } else {
+        advance(*this, C, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool LyapunovEquationWith2DWhiteForcing::sample(Matrix &C, double& t, double tMax, double dtOut,
+                                                const Observer& observer) const {
+    return sampleDense(*this, C, t, tMax, dtOut, observer, _counters);
+}
+
 Matrix LyapunovEquationWith3DWhiteForcing::FFdag(double t) const {
     Matrix M = ZeroMatrix(4, 4);
     M(x, x) = 1 / norm(_k(t));
@@ -151,10 +405,28 @@ Matrix LyapunovEquationWith3DWhiteForcing::FFdag(double t) const {
 
 void LyapunovEquationWith3DWhiteForcing::make_step_forward(Matrix &C, double& t) const {
     double dt = get_dt(t);
-    ode::integrate(*this, C, t, t + dt, dt);
+    advance(*this, C, t, t + dt, dt, _counters);
     t += dt;
 }
 
+bool LyapunovEquationWith3DWhiteForcing::make_step_forward(Matrix &C, double& t, double tMax) const {
+    double dt = get_dt(t);
+    if (t + dt < tMax) {
+        advance(*this, C, t, t + dt, dt, _counters);
+        t += dt;
+        return false;
+    } else {
+        advance(*this, C, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool LyapunovEquationWith3DWhiteForcing::sample(Matrix &C, double& t, double tMax, double dtOut,
+                                                const Observer& observer) const {
+    return sampleDense(*this, C, t, tMax, dtOut, observer, _counters);
+}
+
 Matrix LyapunovEquationWith2DVorticalWhiteForcing::FFdag(double t) const {
     Matrix M = ZeroMatrix(4, 4);
     M(x, x) =  _k.y()  * _k.y()  / norm(_k(t));
@@ -166,10 +438,28 @@ Matrix LyapunovEquationWith2DVorticalWhiteForcing::FFdag(double t) const {
 
 void LyapunovEquationWith2DVorticalWhiteForcing::make_step_forward(Matrix &C, double& t) const {
     double dt = get_dt(t);
-    ode::integrate(*this, C, t, t + dt, dt);
+    advance(*this, C, t, t + dt, dt, _counters);
     t += dt;
 }
 
+bool LyapunovEquationWith2DVorticalWhiteForcing::make_step_forward(Matrix &C, double& t, double tMax) const {
+    double dt = get_dt(t);
+    if (t + dt < tMax) {
+        advance(*this, C, t, t + dt, dt, _counters);
+        t += dt;
+        return false;
+    } else {
+        advance(*this, C, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool LyapunovEquationWith2DVorticalWhiteForcing::sample(Matrix &C, double& t, double tMax, double dtOut,
+                                                        const Observer& observer) const {
+    return sampleDense(*this, C, t, tMax, dtOut, observer, _counters);
+}
+
 Matrix LyapunovEquationWith2DSoundWhiteForcing::FFdag(double t) const {
     Matrix M = ZeroMatrix(4, 4);
     M(x, x) = _k.x(t) * _k.x(t) / norm(_k(t));
@@ -181,10 +471,28 @@ Matrix LyapunovEquationWith2DSoundWhiteForcing::FFdag(double t) const {
 
 void LyapunovEquationWith2DSoundWhiteForcing::make_step_forward(Matrix &C, double& t) const {
     double dt = get_dt(t);
-    ode::integrate(*this, C, t, t + dt, dt);
+    advance(*this, C, t, t + dt, dt, _counters);
     t += dt;
 }
 
+bool LyapunovEquationWith2DSoundWhiteForcing::make_step_forward(Matrix &C, double& t, double tMax) const {
+    double dt = get_dt(t);
+    if (t + dt < tMax) {
+        advance(*this, C, t, t + dt, dt, _counters);
+        t += dt;
+        return false;
+    } else {
+        advance(*this, C, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool LyapunovEquationWith2DSoundWhiteForcing::sample(Matrix &C, double& t, double tMax, double dtOut,
+                                                     const Observer& observer) const {
+    return sampleDense(*this, C, t, tMax, dtOut, observer, _counters);
+}
+
 
 Matrix LyapunovEquationWithoutForcing::FFdag(double) const {
     return ZeroMatrix(4, 4);
@@ -192,19 +500,481 @@ Matrix LyapunovEquationWithoutForcing::FFdag(double) const {
 
 void LyapunovEquationWithoutForcing::make_step_forward(Matrix &C, double& t) const {
     double dt = get_dt(t);
-    ode::integrate(*this, C, t, t + dt, dt);
+    advance(*this, C, t, t + dt, dt, _counters);
     t += dt;
 }
 
 bool LyapunovEquationWithoutForcing::make_step_forward(Matrix &C, double& t, double tMax) const {
     double dt = get_dt(t);
     if (t + dt < tMax) {
-        ode::integrate(*this, C, t, t + dt, dt);
+        advance(*this, C, t, t + dt, dt, _counters);
+        t += dt;
+        return false;
+    } else {
+        advance(*this, C, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool LyapunovEquationWithoutForcing::sample(Matrix &C, double& t, double tMax, double dtOut,
+                                            const Observer& observer) const {
+    return sampleDense(*this, C, t, tMax, dtOut, observer, _counters);
+}
+
+std::string forcingName(Forcing forcing) {
+    switch (forcing) {
+        case Forcing::Flat:
+            return "Flat";
+        case Forcing::Flat2D:
+            return "Flat2D";
+        case Forcing::White2D:
+            return "White2D";
+        case Forcing::White3D:
+            return "White3D";
+        case Forcing::VorticalWhite2D:
+            return "VorticalWhite2D";
+        case Forcing::SoundWhite2D:
+            return "SoundWhite2D";
+        default:
+            return "None";
+    }
+}
+
+Forcing forcingFromName(const std::string& name) {
+    for (Forcing forcing : {Forcing::Flat, Forcing::Flat2D, Forcing::White2D, Forcing::White3D,
+                            Forcing::VorticalWhite2D, Forcing::SoundWhite2D, Forcing::None}) {
+        if (forcingName(forcing) == name) {
+            return forcing;
+        }
+    }
+    throw std::invalid_argument("Unknown forcing " + name);
+}
+
+std::string sensitivityName(Sensitivity parameter) {
+    switch (parameter) {
+        case Sensitivity::Kx:
+            return "kx";
+        case Sensitivity::Ky:
+            return "ky";
+        case Sensitivity::Kz:
+            return "kz";
+        default:
+            return "R";
+    }
+}
+
+Sensitivity sensitivityFromName(const std::string& name) {
+    for (Sensitivity parameter : {Sensitivity::Kx, Sensitivity::Ky, Sensitivity::Kz, Sensitivity::R}) {
+        if (sensitivityName(parameter) == name) {
+            return parameter;
+        }
+    }
+    throw std::invalid_argument("Unknown sensitivity parameter " + name);
+}
+
+Matrix StateTransitionEquation::FFdag(double) const {
+    return ZeroMatrix(4, 4);
+}
+
+void StateTransitionEquation::operator ()(const Matrix& Phi, Matrix& dPhidt, double t) {
+    if (_counters != nullptr) {
+        ++_counters->rhs;
+    }
+    dPhidt = ublas::prod(A(t), Phi);
+}
+
+void StateTransitionEquation::make_step_forward(Matrix &Phi, double& t) const {
+    double dt = get_dt(t);
+    advance(*this, Phi, t, t + dt, dt, _counters);
+    t += dt;
+}
+
+bool StateTransitionEquation::make_step_forward(Matrix &Phi, double& t, double tMax) const {
+    double dt = get_dt(t);
+    if (t + dt < tMax) {
+        advance(*this, Phi, t, t + dt, dt, _counters);
+        t += dt;
+        return false;
+    } else {
+        advance(*this, Phi, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool StateTransitionEquation::sample(Matrix &Phi, double& t, double tMax, double dtOut,
+                                     const Observer& observer) const {
+    return sampleDense(*this, Phi, t, tMax, dtOut, observer, _counters);
+}
+
+std::shared_ptr <AbstractLyapunovEquation> make_equation(Forcing forcing, const Parameters& data, const WaveVector& k) {
+    switch (forcing) {
+        case Forcing::Flat:
+            return std::make_shared <LyapunovEquationWithFlatForcing> (data, k);
+        case Forcing::Flat2D:
+            return std::make_shared <LyapunovEquationWith2DFlatForcing> (data, k);
+        case Forcing::White2D:
+            return std::make_shared <LyapunovEquationWith2DWhiteForcing> (data, k);
+        case Forcing::White3D:
+            return std::make_shared <LyapunovEquationWith3DWhiteForcing> (data, k);
+        case Forcing::VorticalWhite2D:
+            return std::make_shared <LyapunovEquationWith2DVorticalWhiteForcing> (data, k);
+        case Forcing::SoundWhite2D:
+            return std::make_shared <LyapunovEquationWith2DSoundWhiteForcing> (data, k);
+        default:
+            return std::make_shared <LyapunovEquationWithoutForcing> (data, k);
+    }
+}
+
+LyapunovEquationWithMultipleForcing::LyapunovEquationWithMultipleForcing(const Parameters& data, const WaveVector& k,
+                                                                         const std::vector <Forcing>& forcings) :
+    AbstractLyapunovEquation(data, k),
+    _models() {
+    for (Forcing forcing : forcings) {
+        _models.push_back(make_equation(forcing, data, k));
+    }
+}
+
+Matrix LyapunovEquationWithMultipleForcing::FFdag(double t) const {
+    Matrix M = ZeroMatrix(4, 4);
+    for (const auto& model : _models) {
+        M += model->FFdag(t);
+    }
+    return M;
+}
+
+void LyapunovEquationWithMultipleForcing::operator ()(const Matrix& C, Matrix& dCdt, double t) {
+    if (_counters != nullptr) {
+        ++_counters->rhs;
+    }
+    // C(t) is symmetric, so C * A^T = (A * C)^T for every block
+    const Matrix AC = ublas::prod(A(t), C);
+    dCdt.resize(4, C.size2(), false);
+    for (size_t n = 0; n < _models.size(); ++n) {
+        const Matrix F = _models[n]->FFdag(t);
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t j = 0; j < 4; ++j) {
+                dCdt(i, 4 * n + j) = F(i, j) + AC(i, 4 * n + j) + AC(j, 4 * n + i);
+            }
+        }
+    }
+}
+
+void LyapunovEquationWithMultipleForcing::make_step_forward(Matrix &C, double& t) const {
+    double dt = get_dt(t);
+    advance(*this, C, t, t + dt, dt, _counters);
+    t += dt;
+}
+
+bool LyapunovEquationWithMultipleForcing::make_step_forward(Matrix &C, double& t, double tMax) const {
+    double dt = get_dt(t);
+    if (t + dt < tMax) {
+        advance(*this, C, t, t + dt, dt, _counters);
+        t += dt;
+        return false;
+    } else {
+        advance(*this, C, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool LyapunovEquationWithMultipleForcing::sample(Matrix &C, double& t, double tMax, double dtOut,
+                                                 const Observer& observer) const {
+    return sampleDense(*this, C, t, tMax, dtOut, observer, _counters);
+}
+
+TangentLinearEquation::TangentLinearEquation(const Parameters& data, const WaveVector& k, Forcing forcing,
+                                             const std::vector <Sensitivity>& parameters) :
+    AbstractLyapunovEquation(data, k),
+    _forcing(forcing),
+    _model(make_equation(forcing, data, k)),
+    _parameters(parameters) {}
+
+Matrix TangentLinearEquation::FFdag(double t) const {
+    return _model->FFdag(t);
+}
+
+void TangentLinearEquation::derivatives(Sensitivity parameter, double t, double dA[4][4], double dQ[4][4]) const {
+    const double k[3] = {_k.x(t), _k.y(), _k.z()};
+
+    // dk(t)/dp, kx(t) = kx + q ky t depends on ky
+    double d[3] = {0, 0, 0};
+    double dInvRe = 0;
+    switch (parameter) {
+        case Sensitivity::Kx: d[x] = 1;                break;
+        case Sensitivity::Ky: d[x] = _q * t; d[y] = 1; break;
+        case Sensitivity::Kz: d[z] = 1;                break;
+        case Sensitivity::R:  dInvRe = -_invRe * _invRe; break;
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            dA[i][j] = 0;
+            dQ[i][j] = 0;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        dA[i][w] =  d[i];
+        dA[w][i] = -d[i];
+    }
+
+    const double k2 = k[x] * k[x] + k[y] * k[y] + k[z] * k[z];
+    const double kd = k[x] * d[x] + k[y] * d[y] + k[z] * d[z];
+    if (_regime != Regime::Inviscid) {
+        // the same viscous terms as in fillA(), _invRe_b includes 1 / (3 R)
+        for (int i = 0; i < 3; ++i) {
+            dA[i][i] -= 2 * kd * _invRe + k2 * dInvRe;
+            for (int j = 0; j < 3; ++j) {
+                dA[i][j] -= (d[i] * k[j] + k[i] * d[j]) * _invRe_b + k[i] * k[j] * dInvRe / 3.0;
+            }
+        }
+    }
+
+    // the same terms as in FFdag() of the forcing models
+    const double k2D = k[x] * k[x] + k[y] * k[y];
+    const double kd2D = k[x] * d[x] + k[y] * d[y];
+    switch (_forcing) {
+        case Forcing::White2D:
+            for (int i = 0; i < 3; ++i) {
+                dQ[i][i] = -kd2D / (k2D * std::sqrt(k2D));
+            }
+            break;
+        case Forcing::White3D:
+            for (int i = 0; i < 3; ++i) {
+                dQ[i][i] = -2 * kd / (k2 * k2);
+            }
+            break;
+        case Forcing::VorticalWhite2D:
+            // (f / k^2)' = f' / k^2 - 2 f (k d) / k^4
+            dQ[x][x] =  (2 * k[y] * d[y]                 - 2 * k[y] * k[y] * kd / k2) / k2;
+            dQ[x][y] = -(d[x] * k[y] + k[x] * d[y]       - 2 * k[x] * k[y] * kd / k2) / k2;
+            dQ[y][x] =  dQ[x][y];
+            dQ[y][y] =  (2 * k[x] * d[x]                 - 2 * k[x] * k[x] * kd / k2) / k2;
+            break;
+        case Forcing::SoundWhite2D:
+            dQ[x][x] =  (2 * k[x] * d[x]                 - 2 * k[x] * k[x] * kd / k2) / k2;
+            dQ[x][y] =  (d[x] * k[y] + k[x] * d[y]       - 2 * k[x] * k[y] * kd / k2) / k2;
+            dQ[y][x] =  dQ[x][y];
+            dQ[y][y] =  (2 * k[y] * d[y]                 - 2 * k[y] * k[y] * kd / k2) / k2;
+            break;
+        default:
+            // flat forcings do not depend on k
+            break;
+    }
+}
+
+void TangentLinearEquation::operator ()(const Matrix& S, Matrix& dSdt, double t) {
+    if (_counters != nullptr) {
+        ++_counters->rhs;
+    }
+    double a[4][4];
+    switch (_regime) {
+        case Regime::Inviscid:    fillA <Regime::Inviscid>    (a, t); break;
+        case Regime::Viscous:     fillA <Regime::Viscous>     (a, t); break;
+        case Regime::BulkViscous: fillA <Regime::BulkViscous> (a, t); break;
+    }
+
+    // every block is symmetric, so the kernel of the Lyapunov equation applies to each of them
+    const Matrix Q = FFdag(t);
+    dSdt.resize(S.size1(), 4, false);
+    const double* s = &S.data()[0];
+    double* ds = &dSdt.data()[0];
+    _kernels.lyapunovRhs(&a[0][0], s, &Q.data()[0], ds);
+    for (size_t n = 0; n < _parameters.size(); ++n) {
+        double dA[4][4];
+        double dQ[4][4];
+        double source[16];
+        derivatives(_parameters[n], t, dA, dQ);
+        _kernels.lyapunovRhs(&dA[0][0], s, &dQ[0][0], source);
+        _kernels.lyapunovRhs(&a[0][0], s + 16 * (n + 1), source, ds + 16 * (n + 1));
+    }
+}
+
+double TangentLinearEquation::forsingPowerDerivative(size_t n, double t) const {
+    double dA[4][4];
+    double dQ[4][4];
+    derivatives(_parameters[n], t, dA, dQ);
+    return dQ[x][x] + dQ[y][y] + dQ[z][z] + dQ[w][w];
+}
+
+void TangentLinearEquation::make_step_forward(Matrix &S, double& t) const {
+    double dt = get_dt(t);
+    advanceControlled(*this, TangentStepper(), S, t, t + dt, dt, _counters);
+    t += dt;
+}
+
+bool TangentLinearEquation::make_step_forward(Matrix &S, double& t, double tMax) const {
+    double dt = get_dt(t);
+    if (t + dt < tMax) {
+        advanceControlled(*this, TangentStepper(), S, t, t + dt, dt, _counters);
         t += dt;
         return false;
     } else {
-        ode::integrate(*this, C, t, tMax, dt);
+        advanceControlled(*this, TangentStepper(), S, t, tMax, dt, _counters);
+        t = tMax;
+        return true;
+    }
+}
+
+bool TangentLinearEquation::sample(Matrix &S, double& t, double tMax, double dtOut,
+                                   const Observer& observer) const {
+    return sampleDense(*this, S, t, tMax, dtOut, observer, _counters);
+}
+
+MagnusPropagator::Generator MagnusPropagator::generator(double t) const {
+    if (_eq._counters != nullptr) {
+        ++_eq._counters->rhs;
+    }
+    const Matrix A = _eq.A(t);
+    const Matrix Q = _eq.FFdag(t);
+
+    // index of the entry C(i, j) = C(j, i) in the state
+    int index[4][4];
+    for (int i = 0, n = 0; i < 4; ++i) {
+        for (int j = i; j < 4; ++j, ++n) {
+            index[i][j] = n;
+            index[j][i] = n;
+        }
+    }
+    constexpr int E   = 10;
+    constexpr int I   = 11;
+    constexpr int EIn = 12;
+    constexpr int one = 13;
+
+    Generator G = {};
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i; j < 4; ++j) {
+            const int row = index[i][j];
+            for (int k = 0; k < 4; ++k) {
+                G[N * row + index[k][j]] += A(i, k);
+                G[N * row + index[i][k]] += A(j, k);
+            }
+            G[N * row + one] = Q(i, j);
+        }
+        G[N * E + index[i][i]] = 1;
+    }
+    G[N * I + index[0][1]] = 1;
+    G[N * EIn + one] = Q(0, 0) + Q(1, 1) + Q(2, 2) + Q(3, 3);
+    return G;
+}
+
+MagnusPropagator::Generator MagnusPropagator::multiply(const Generator& a, const Generator& b) const {
+    Generator c;
+    _eq._kernels.multiply(N, a.data(), b.data(), c.data());
+    return c;
+}
+
+MagnusPropagator::State MagnusPropagator::step(const State& y, double t, double dt) const {
+    const double c = std::sqrt(3.0) / 6.0;
+    const Generator G1 = generator(t + (0.5 - c) * dt);
+    const Generator G2 = generator(t + (0.5 + c) * dt);
+    const Generator G21 = multiply(G2, G1);
+    const Generator G12 = multiply(G1, G2);
+
+    Generator Omega;
+    double norm = 0;
+    for (int i = 0; i < N; ++i) {
+        double row = 0;
+        for (int j = 0; j < N; ++j) {
+            const int n = N * i + j;
+            Omega[n] = 0.5 * dt * (G1[n] + G2[n]) + c * 0.5 * dt * dt * (G21[n] - G12[n]);
+            row += std::abs(Omega[n]);
+        }
+        norm = std::max(norm, row);
+    }
+
+    // exp(Omega) by Taylor series of exp(Omega / 2^s) with norm below 1/2 and s squarings
+    int s = 0;
+    while (norm > 0.5) {
+        norm *= 0.5;
+        ++s;
+    }
+    const double scale = std::ldexp(1.0, -s);
+    for (double& omega : Omega) {
+        omega *= scale;
+    }
+    constexpr int degree = 12;
+    Generator exp = {};
+    for (int i = 0; i < N; ++i) {
+        exp[N * i + i] = 1;
+    }
+    for (int m = degree; m > 0; --m) {
+        exp = multiply(Omega, exp);
+        for (double& e : exp) {
+            e /= m;
+        }
+        for (int i = 0; i < N; ++i) {
+            exp[N * i + i] += 1;
+        }
+    }
+    for (int n = 0; n < s; ++n) {
+        exp = multiply(exp, exp);
+    }
+
+    State yNew = {};
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            yNew[i] += exp[N * i + j] * y[j];
+        }
+    }
+    return yNew;
+}
+
+bool MagnusPropagator::make_step_forward(Matrix& C, double& t, double tMax, double& E, double& I, double& EIn) {
+    State y = {};
+    for (int i = 0, n = 0; i < 4; ++i) {
+        for (int j = i; j < 4; ++j, ++n) {
+            y[n] = C(i, j);
+        }
+    }
+    y[N - 1] = 1;
+
+    PhaseCounters* counters = _eq._counters;
+    const double tiny = 1e-14 * std::max(1.0, std::abs(t));
+    if (tMax - t <= tiny) {
         t = tMax;
         return true;
     }
+    while (true) {
+        const bool last = (t + _dt >= tMax);
+        const double dt = last ? tMax - t : _dt;
+        if (dt <= tiny) {
+            throw std::runtime_error("MagnusPropagator: step size underflow");
+        }
+
+        const State yFull = step(y, t, dt);
+        const State yHalf = step(step(y, t, 0.5 * dt), t + 0.5 * dt, 0.5 * dt);
+        double error = 0;
+        for (int i = 0; i < N - 1; ++i) {
+            error = std::max(error, std::abs(yHalf[i] - yFull[i]) / (_tolerance * (1 + std::abs(yHalf[i]))));
+        }
+        // the order of the error estimate is 5
+        const double factor = std::min(5.0, std::max(0.2, 0.9 * std::pow(std::max(error, 1e-10), -0.2)));
+        if (error > 1) {
+            _dt = dt * factor;
+            if (counters != nullptr) {
+                ++counters->rejected;
+            }
+            continue;
+        }
+        _dt = last ? std::max(_dt, dt * factor) : dt * factor;
+
+        for (int i = 0, n = 0; i < 4; ++i) {
+            for (int j = i; j < 4; ++j, ++n) {
+                C(i, j) = yHalf[n] + (yHalf[n] - yFull[n]) / 15;
+                C(j, i) = C(i, j);
+            }
+        }
+        E   += yHalf[10] + (yHalf[10] - yFull[10]) / 15;
+        I   += yHalf[11] + (yHalf[11] - yFull[11]) / 15;
+        EIn += yHalf[12] + (yHalf[12] - yFull[12]) / 15;
+        t = last ? tMax : t + dt;
+        if (counters != nullptr) {
+            ++counters->accepted;
+            ++counters->steps;
+        }
+        return last;
+    }
 }
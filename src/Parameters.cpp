@@ -13,16 +13,107 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 #include <array>
 #include <string>
 #include <sstream>
+#include <stdexcept>
 #include <fstream>
 
 #include <boost/program_options.hpp>
 
 namespace po = boost::program_options;
 
-Parameters::ParamsArray Parameters::InitParams(int ac, char* av[]) {
+std::string stepperName(Stepper stepper) {
+    switch (stepper) {
+        case Stepper::RungeKutta: return "rk";
+        case Stepper::Magnus:     return "magnus";
+    }
+    return "";
+}
+
+Stepper stepperFromName(const std::string& name) {
+    for (Stepper stepper : {Stepper::RungeKutta, Stepper::Magnus}) {
+        if (stepperName(stepper) == name) {
+            return stepper;
+        }
+    }
+    throw std::invalid_argument("Unknown stepper " + name);
+}
+
+std::string affinityName(Affinity affinity) {
+    switch (affinity) {
+        case Affinity::None:    return "none";
+        case Affinity::Compact: return "compact";
+        case Affinity::Spread:  return "spread";
+    }
+    return "";
+}
+
+Affinity affinityFromName(const std::string& name) {
+    for (Affinity affinity : {Affinity::None, Affinity::Compact, Affinity::Spread}) {
+        if (affinityName(affinity) == name) {
+            return affinity;
+        }
+    }
+    throw std::invalid_argument("Unknown affinity " + name);
+}
+
+std::string isaName(Isa isa) {
+    switch (isa) {
+        case Isa::Auto:    return "auto";
+        case Isa::Generic: return "generic";
+        case Isa::Sse42:   return "sse4.2";
+        case Isa::Avx2:    return "avx2";
+        case Isa::Avx512:  return "avx512";
+    }
+    return "";
+}
+
+Isa isaFromName(const std::string& name) {
+    for (Isa isa : {Isa::Auto, Isa::Generic, Isa::Sse42, Isa::Avx2, Isa::Avx512}) {
+        if (isaName(isa) == name) {
+            return isa;
+        }
+    }
+    throw std::invalid_argument("Unknown instruction set " + name);
+}
+
+std::string reductionName(Reduction reduction) {
+    switch (reduction) {
+        case Reduction::Energy:      return "energy";
+        case Reduction::Components:  return "components";
+        case Reduction::Dissipation: return "dissipation";
+        case Reduction::Peak:        return "peak";
+    }
+    return "";
+}
+
+Reduction reductionFromName(const std::string& name) {
+    for (Reduction reduction : {Reduction::Energy, Reduction::Components, Reduction::Dissipation, Reduction::Peak}) {
+        if (reductionName(reduction) == name) {
+            return reduction;
+        }
+    }
+    throw std::invalid_argument("Unknown reducer " + name);
+}
+
+std::vector <Reduction> reductionsFromNames(const std::string& names) {
+    std::vector <Reduction> reductions;
+    std::stringstream ss(names);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        if (!name.empty()) {
+            reductions.push_back(reductionFromName(name));
+        }
+    }
+    return reductions;
+}
+
+Parameters::ParamsArray Parameters::InitParams(int ac, char* av[], const po::options_description& driverOptions) {
     Parameters::ParamsArray pA;
     std::string Re;
     std::string Re_b;
+    std::string forcedStepper;
+    std::string freeStepper;
+    std::string affinity;
+    std::string isa;
 
     po::options_description data("Allowed options");
     data.add_options()
@@ -31,14 +122,39 @@ Parameters::ParamsArray Parameters::InitParams(int ac, char* av[]) {
      ("R",        po::value <std::string> (&Re)              -> default_value("inf"),   "Reynolds number")
      ("R_b",      po::value <std::string> (&Re_b)            -> default_value("inf"),   "Second Reynolds number")
      ("Ct",       po::value <double> (&pA[CtPosition])       -> default_value(0.1),     "Courant constant")
-     ("Nt",       po::value <double> (&pA[NtPosition])       -> default_value(1),       "Number of threads");
+     ("Nt",       po::value <double> (&pA[NtPosition])       -> default_value(1),       "Number of threads")
+     ("progress", po::value <double> (&pA[progressPosition]) -> default_value(0),       "Progress report interval, s")
+     ("richardson", po::value <double> (&pA[richardsonPosition]) -> default_value(1),   "Number of Ct levels of Richardson extrapolation")
+     ("forcedStepper", po::value <std::string> (&forcedStepper) -> default_value("rk"), "Forced phase: rk, magnus")
+     ("freeStepper",   po::value <std::string> (&freeStepper)   -> default_value("rk"), "Free phase: rk, magnus")
+     ("affinity", po::value <std::string> (&affinity) -> default_value("none"), "Thread placement: none, compact, spread")
+     ("isa",      po::value <std::string> (&isa)      -> default_value("auto"), "ISA of RHS, Magnus products, ensemble")
+     ("autotune", po::value <double> (&pA[autotunePosition]) -> default_value(0),       "Autotune tolerance, 0 is off")
+     ("cubature", po::value <double> (&pA[cubaturePosition]) -> default_value(0),       "Cubature tolerance, 0 is off")
+     ("status",   po::value <std::string> (&_sA[statusPosition])   -> default_value(""), "Progress status file")
+     ("counters", po::value <std::string> (&_sA[countersPosition]) -> default_value(""), "Instrumentation output file")
+     ("reducers", po::value <std::string> (&_sA[reducersPosition]) -> default_value(""), "Diagnostic reducers");
 
+    // options of the driver are parsed here only to reject unknown ones, the driver parses them again
+    po::options_description all;
+    all.add(data).add(driverOptions);
     po::variables_map vm;
-    po::store(po::parse_command_line(ac, av, data), vm);
+    po::store(po::command_line_parser(ac, av).options(all).run(), vm);
     po::notify(vm);
 
     if (vm.count("help")) {
-        std::cout << data << std::endl;
+        std::cout << all << std::endl;
+    }
+
+    pA.at(forcedStepperPosition) = static_cast <double> (stepperFromName(forcedStepper));
+    pA.at(freeStepperPosition)   = static_cast <double> (stepperFromName(freeStepper));
+    pA.at(affinityPosition)      = static_cast <double> (affinityFromName(affinity));
+    pA.at(isaPosition)           = static_cast <double> (isaFromName(isa));
+
+    // reducers sample the accepted steps, Magnus steps span many acoustic periods
+    if (!_sA[reducersPosition].empty() && ((stepperFromName(forcedStepper) == Stepper::Magnus) ||
+                                          (stepperFromName(freeStepper)   == Stepper::Magnus))) {
+        throw std::invalid_argument("--reducers need --forcedStepper=rk and --freeStepper=rk");
     }
 
     if (Re.compare("inf") == 0) {
@@ -77,12 +193,94 @@ Parameters::ParamsArray Parameters::InitParams(int ac, char* av[]) {
 }
 
 Parameters::Parameters(int ac, char** av) :
-    _pA(InitParams(ac, av)),
+    Parameters(ac, av, po::options_description()) {}
+
+Parameters::Parameters(int ac, char** av, const po::options_description& driverOptions) :
+    _sA(),
+    _pA(InitParams(ac, av, driverOptions)),
     q(_pA[qPosition]),
     invRe(_pA.at(invRePosition)),
     invRe_b(_pA.at(invRe_bPosition)),
     Ct(_pA.at(CtPosition)),
-    Nt(static_cast <int> (_pA.at(NtPosition))) {}
+    Nt(static_cast <int> (_pA.at(NtPosition))),
+    progress(_pA.at(progressPosition)),
+    richardson(static_cast <int> (_pA.at(richardsonPosition))),
+    forcedStepper(static_cast <Stepper> (static_cast <int> (_pA.at(forcedStepperPosition)))),
+    freeStepper(static_cast <Stepper> (static_cast <int> (_pA.at(freeStepperPosition)))),
+    affinity(static_cast <Affinity> (static_cast <int> (_pA.at(affinityPosition)))),
+    isa(static_cast <Isa> (static_cast <int> (_pA.at(isaPosition)))),
+    autotune(_pA.at(autotunePosition)),
+    cubature(_pA.at(cubaturePosition)),
+    counters(_sA.at(countersPosition)),
+    status(_sA.at(statusPosition)),
+    reducers(_sA.at(reducersPosition)),
+    reductions(reductionsFromNames(reducers)) {}
+
+Parameters::Parameters(const ParamsArray& pA, const StrParamsArray& sA, const std::vector <Reduction>& reductionList) :
+    _sA(sA),
+    _pA(pA),
+    q(_pA[qPosition]),
+    invRe(_pA.at(invRePosition)),
+    invRe_b(_pA.at(invRe_bPosition)),
+    Ct(_pA.at(CtPosition)),
+    Nt(static_cast <int> (_pA.at(NtPosition))),
+    progress(_pA.at(progressPosition)),
+    richardson(static_cast <int> (_pA.at(richardsonPosition))),
+    forcedStepper(static_cast <Stepper> (static_cast <int> (_pA.at(forcedStepperPosition)))),
+    freeStepper(static_cast <Stepper> (static_cast <int> (_pA.at(freeStepperPosition)))),
+    affinity(static_cast <Affinity> (static_cast <int> (_pA.at(affinityPosition)))),
+    isa(static_cast <Isa> (static_cast <int> (_pA.at(isaPosition)))),
+    autotune(_pA.at(autotunePosition)),
+    cubature(_pA.at(cubaturePosition)),
+    counters(_sA.at(countersPosition)),
+    status(_sA.at(statusPosition)),
+    reducers(_sA.at(reducersPosition)),
+    reductions(reductionList) {}
+
+Parameters::Parameters(double shear, double invReynolds, double invReynolds_b, double Courant, int nThreads) :
+    Parameters(ParamsArray{{shear, invReynolds, invReynolds_b, Courant, static_cast <double> (nThreads),
+                            0, 1, 0, 0, 0, 0, 0, 0}},
+               StrParamsArray(), std::vector <Reduction> ()) {}
+
+Parameters Parameters::withNt(int nThreads) const {
+    ParamsArray pA = _pA;
+    pA.at(NtPosition) = nThreads;
+    return Parameters(pA, _sA, reductions);
+}
+
+Parameters Parameters::withCt(double Courant) const {
+    ParamsArray pA = _pA;
+    pA.at(CtPosition) = Courant;
+    return Parameters(pA, _sA, reductions);
+}
+
+Parameters Parameters::withInvRe(double invReynolds, double invReynolds_b) const {
+    ParamsArray pA = _pA;
+    pA.at(invRePosition)   = invReynolds;
+    pA.at(invRe_bPosition) = invReynolds_b;
+    return Parameters(pA, _sA, reductions);
+}
+
+Parameters Parameters::withSteppers(Stepper forced, Stepper free) const {
+    ParamsArray pA = _pA;
+    pA.at(forcedStepperPosition) = static_cast <double> (forced);
+    pA.at(freeStepperPosition)   = static_cast <double> (free);
+    return Parameters(pA, _sA, reductions);
+}
+
+Parameters Parameters::withRichardson(int levels) const {
+    ParamsArray pA = _pA;
+    pA.at(richardsonPosition) = levels;
+    return Parameters(pA, _sA, reductions);
+}
+
+Parameters Parameters::withoutReports() const {
+    ParamsArray pA = _pA;
+    pA.at(progressPosition) = 0;
+    StrParamsArray sA;
+    sA.at(reducersPosition) = _sA.at(reducersPosition);
+    return Parameters(pA, sA, reductions);
+}
 
 std::string Parameters::params2Str() const {
     std::stringstream ss;
@@ -93,6 +291,19 @@ std::string Parameters::params2Str() const {
     return ss.str();
 }
 
+std::string Parameters::integrator2Str() const {
+    std::stringstream ss;
+    ss << "Ct = " << Ct << " richardson = " << richardson << " ";
+    ss << "forcedStepper = " << stepperName(forcedStepper) << " freeStepper = " << stepperName(freeStepper);
+    return ss.str();
+}
+
+void Parameters::outputTuning(std::ostream& os) const {
+    if (autotune > 0) {
+        os << "# autotuned to tolerance " << autotune << ": " << integrator2Str() << "\n";
+    }
+}
+
 std::ofstream& operator << (std::ofstream& os, const Parameters& data) {
     os << data.q << "\t" << 1.0 / data.invRe << "\t" << 1.0 / data.invRe_b;
     return os;
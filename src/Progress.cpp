@@ -0,0 +1,139 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Progress.h"
+
+#include <unistd.h>
+#include <omp.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "include/Affinity.h"
+#include "include/Parameters.h"
+
+// resident set size of the process, bytes
+inline uint64_t residentMemory() {
+    std::ifstream fStatm("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    fStatm >> size >> resident;
+    return resident * static_cast <uint64_t> (sysconf(_SC_PAGESIZE));
+}
+
+Progress::Counter* Progress::newCounters(size_t n) {
+    void* memory = nullptr;
+    if (posix_memalign(&memory, alignof(Counter), n * sizeof(Counter)) != 0) {
+        throw std::bad_alloc();
+    }
+    Counter* counters = static_cast <Counter*> (memory);
+    for (size_t i = 0; i < n; ++i) {
+        new (counters + i) Counter();
+    }
+    return counters;
+}
+
+Progress::Progress(const Parameters& data, const std::string& name, uint64_t nCells) :
+    _name(name),
+    _nCells(nCells),
+    _interval(data.progress),
+    _status(data.status),
+    _nThreads(data.Nt > 0 ? data.Nt : 1),
+    _nSockets(nSockets()),
+    _start(omp_get_wtime()),
+    _counters(newCounters(static_cast <size_t> (_nThreads * _nSockets)), std::free),
+    _lastCounts(_nThreads * _nSockets, 0),
+    _lastTime(_start),
+    _stop(false),
+    _mutex(),
+    _cv(),
+    _thread() {
+    if (_interval > 0) {
+        _thread = std::thread(&Progress::run, this);
+    }
+}
+
+Progress::~Progress() {
+    if (_thread.joinable()) {
+        {
+            std::lock_guard <std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_one();
+        _thread.join();
+        report(true);
+    }
+}
+
+void Progress::run() {
+    // the thread inherits the single CPU of the thread which created it and would compete with its worker
+    unbindThread();
+    std::unique_lock <std::mutex> lock(_mutex);
+    while (!_cv.wait_for(lock, std::chrono::duration <double> (_interval), [this]() { return _stop; })) {
+        report(false);
+    }
+}
+
+void Progress::report(bool final) {
+    const double time = omp_get_wtime();
+
+    uint64_t done = 0;
+    std::stringstream threads;
+    std::vector <uint64_t> socketCounts(_nSockets, 0);
+    for (int i = 0; i < _nThreads; ++i) {
+        uint64_t threadCount = 0;
+        for (int s = 0; s < _nSockets; ++s) {
+            const int j = i * _nSockets + s;
+            const uint64_t count = _counters[j].n.load(std::memory_order_relaxed);
+            threadCount     += count - _lastCounts[j];
+            socketCounts[s] += count - _lastCounts[j];
+            _lastCounts[j] = count;
+            done += count;
+        }
+        threads << " " << threadCount;
+    }
+    std::stringstream sockets;
+    for (uint64_t count : socketCounts) {
+        sockets << " " << count;
+    }
+    const double elapsed = time - _start;
+    const double rate    = elapsed > 0 ? static_cast <double> (done) / elapsed : 0;
+    const double eta     = rate > 0 ? static_cast <double> (_nCells - done) / rate : -1;
+    const double memory  = static_cast <double> (residentMemory()) / (1 << 20);
+
+    fprintf(stderr, "%s: %llu/%llu cells (%.1lf%%), %.3lf cells/s, ETA %.0lf s, RSS %.1lf MB, ",
+            _name.c_str(), static_cast <unsigned long long> (done), static_cast <unsigned long long> (_nCells),
+            100.0 * static_cast <double> (done) / static_cast <double> (_nCells), rate, eta, memory);
+    fprintf(stderr, "cells per thread in last %.1lf s:%s, per socket:%s%s\n",
+            time - _lastTime, threads.str().c_str(), sockets.str().c_str(), final ? " (finished)" : "");
+    _lastTime = time;
+
+    if (!_status.empty()) {
+        const std::string tmpName = _status + ".tmp";
+        std::ofstream fStatus(tmpName);
+        fStatus << "name\t"         << _name          << "\n";
+        fStatus << "finished\t"     << final          << "\n";
+        fStatus << "cells_done\t"   << done           << "\n";
+        fStatus << "cells_total\t"  << _nCells        << "\n";
+        fStatus << "cells_per_s\t"  << rate           << "\n";
+        fStatus << "eta_s\t"        << eta            << "\n";
+        fStatus << "elapsed_s\t"    << elapsed        << "\n";
+        fStatus << "rss_mb\t"       << memory         << "\n";
+        fStatus << "thread_cells\t" << threads.str()  << "\n";  // since the previous report
+        fStatus << "socket_cells\t" << sockets.str()  << "\n";
+        fStatus.close();
+        std::rename(tmpName.c_str(), _status.c_str());
+    }
+}
@@ -0,0 +1,196 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Reducers.h"
+
+#include <algorithm>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "include/LyapunovEquations.h"
+#include "include/Parameters.h"
+#include "include/WaveVector.h"
+
+namespace {
+
+// trapezoid kx-integrals of the quantities returned by Integrand::values
+template <class Integrand>
+class KxIntegral : public Reducer {
+ private:
+    const Integrand _integrand;
+    std::vector <double> _integrals;
+
+ public:
+    explicit KxIntegral(const Integrand& integrand) :
+        _integrand(integrand),
+        _integrals(integrand.names().size(), 0) {}
+
+    void step(const WaveVector& k, double t0, const Matrix& C0, double t, const Matrix& C) override {
+        const double dkx = k.x(t) - k.x(t0);
+        const std::vector <double> f0 = _integrand.values(k(t0), C0);
+        const std::vector <double> f1 = _integrand.values(k(t),  C);
+        for (size_t n = 0; n < _integrals.size(); ++n) {
+            _integrals[n] += (f0[n] + f1[n]) * 0.5 * dkx;
+        }
+    }
+
+    std::vector <std::string> names() const override {
+        return _integrand.names();
+    }
+
+    void append(std::vector <double>& record) const override {
+        record.insert(record.end(), _integrals.begin(), _integrals.end());
+    }
+};
+
+struct Energy {
+ public:
+    std::vector <std::string> names() const {
+        return {"Kx", "Ax"};
+    }
+
+    std::vector <double> values(const WaveVector&, const Matrix& C) const {
+        return {C(0, 0) + C(1, 1) + C(2, 2), C(3, 3)};
+    }
+};
+
+struct Components {
+ public:
+    std::vector <std::string> names() const {
+        return {"Cxx", "Cyy", "Czz", "Cww"};
+    }
+
+    std::vector <double> values(const WaveVector&, const Matrix& C) const {
+        return {C(0, 0), C(1, 1), C(2, 2), C(3, 3)};
+    }
+};
+
+// -d trace(C) / dt due to the dissipative terms of A, bulk viscosity includes 1 / (3 R) as in the equations
+struct Dissipation {
+ public:
+    const double invRe;
+    const double invRe_b;
+
+    std::vector <std::string> names() const {
+        return {"Dx"};
+    }
+
+    std::vector <double> values(const WaveVector& k, const Matrix& C) const {
+        const double kv[3] = {k.x(), k.y(), k.z()};
+        double kCk = 0;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                kCk += kv[i] * C(i, j) * kv[j];
+            }
+        }
+        return {2 * (invRe * norm(k) * (C(0, 0) + C(1, 1) + C(2, 2)) + invRe_b * kCk)};
+    }
+};
+
+class Peak : public Reducer {
+ private:
+    double _Emax;
+    double _kx;
+
+ public:
+    Peak() : _Emax(0), _kx(0) {}
+
+    void step(const WaveVector& k, double t0, const Matrix& C0, double t, const Matrix& C) override {
+        if (trace(C0) > _Emax) {
+            _Emax = trace(C0);
+            _kx   = k.x(t0);
+        }
+        if (trace(C) > _Emax) {
+            _Emax = trace(C);
+            _kx   = k.x(t);
+        }
+    }
+
+    std::vector <std::string> names() const override {
+        return {"Emax", "kxEmax"};
+    }
+
+    void append(std::vector <double>& record) const override {
+        record.push_back(_Emax);
+        record.push_back(_kx);
+    }
+
+    bool integral() const override {
+        return false;
+    }
+};
+
+std::unique_ptr <Reducer> makeReducer(Reduction reduction, const Parameters& data) {
+    switch (reduction) {
+        case Reduction::Energy:
+            return std::unique_ptr <Reducer> (new KxIntegral <Energy> (Energy()));
+        case Reduction::Components:
+            return std::unique_ptr <Reducer> (new KxIntegral <Components> (Components()));
+        case Reduction::Dissipation:
+            return std::unique_ptr <Reducer> (new KxIntegral <Dissipation> (
+                Dissipation{data.invRe, data.invRe_b + data.invRe / 3.0}));
+        case Reduction::Peak:
+            return std::unique_ptr <Reducer> (new Peak());
+    }
+    return std::unique_ptr <Reducer> ();
+}
+
+}  // namespace
+
+Reducers::Reducers(const Parameters& data) : _reducers() {
+    for (Reduction reduction : data.reductions) {
+        _reducers.push_back(makeReducer(reduction, data));
+    }
+}
+
+void Reducers::step(const WaveVector& k, double t0, const Matrix& C0, double t, const Matrix& C) {
+    for (auto& reducer : _reducers) {
+        reducer->step(k, t0, C0, t, C);
+    }
+}
+
+std::vector <std::string> Reducers::names() const {
+    std::vector <std::string> result;
+    for (const auto& reducer : _reducers) {
+        const std::vector <std::string> names = reducer->names();
+        result.insert(result.end(), names.begin(), names.end());
+    }
+    return result;
+}
+
+std::vector <double> Reducers::record() const {
+    std::vector <double> result;
+    for (const auto& reducer : _reducers) {
+        reducer->append(result);
+    }
+    return result;
+}
+
+std::vector <bool> Reducers::integrals() const {
+    std::vector <bool> result;
+    for (const auto& reducer : _reducers) {
+        const std::vector <bool> integrals(reducer->names().size(), reducer->integral());
+        result.insert(result.end(), integrals.begin(), integrals.end());
+    }
+    return result;
+}
+
+void outputReducedColumns(const Parameters& data, std::ostream& os) {
+    const Reducers reducers(data);
+    if (reducers.empty()) {
+        return;
+    }
+    os << "# reduced columns at the end of rows:";
+    for (const std::string& name : reducers.names()) {
+        os << " " << name;
+    }
+    os << "\n";
+}
@@ -0,0 +1,325 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Server.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <condition_variable>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "include/integrator.h"
+#include "include/LyapunovEquations.h"
+#include "include/Parameters.h"
+
+namespace {
+
+double inverse(const std::string& R) {
+    if (R == "inf") {
+        return 0;
+    }
+    const double x = std::stod(R);
+    if (!(x > 0)) {
+        throw std::invalid_argument("Reynolds number must be positive or inf");
+    }
+    return 1.0 / x;
+}
+
+bool sendAll(int fd, const std::string& message) {
+    size_t sent = 0;
+    while (sent < message.size()) {
+        const ssize_t n = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast <size_t> (n);
+    }
+    return true;
+}
+
+}  // namespace
+
+Server::Server(const Parameters& data, const std::string& socketName, size_t cacheSize) :
+    _data(data),
+    _socketName(socketName),
+    _cacheSize(cacheSize),
+    _mutex(),
+    _taskReady(),
+    _resultReady(),
+    _cache(),
+    _tasks(),
+    _order(),
+    _stopping(false),
+    _listener(-1),
+    _statistics({0, 0, 0, 0, 0}),
+    _workers() {
+    for (int n = 0; n < data.Nt; ++n) {
+        _workers.emplace_back(&Server::worker, this);
+    }
+}
+
+Server::~Server() {
+    {
+        std::lock_guard <std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _taskReady.notify_all();
+    for (std::thread& worker : _workers) {
+        worker.join();
+    }
+}
+
+void Server::worker() {
+    std::unique_lock <std::mutex> lock(_mutex);
+    while (true) {
+        _taskReady.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+        if (_stopping) {
+            return;
+        }
+        const Key key = _tasks.front();
+        _tasks.pop_front();
+        std::shared_ptr <Entry> entry = _cache.at(key);
+        lock.unlock();
+
+        IntegratorOut iOut;
+        std::string error;
+        try {
+            iOut = integrateOverX(_data.withInvRe(std::get <0> (key), std::get <1> (key)), std::get <3> (key),
+                                  std::get <4> (key), std::get <5> (key), std::get <6> (key),
+                                  static_cast <Forcing> (std::get <2> (key)));
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        lock.lock();
+        entry->iOut  = iOut;
+        entry->error = error;
+        entry->done  = true;
+        ++_statistics.computed;
+        if (error.empty()) {
+            _order.push_back(key);
+        } else {
+            _cache.erase(key);
+        }
+        while (_order.size() > _cacheSize) {
+            _cache.erase(_order.front());
+            _order.pop_front();
+        }
+        _resultReady.notify_all();
+    }
+}
+
+std::vector <IntegratorOut> Server::evaluate(const std::vector <Key>& keys) {
+    std::vector <std::shared_ptr <Entry>> entries;
+    entries.reserve(keys.size());
+
+    std::unique_lock <std::mutex> lock(_mutex);
+    _statistics.cells += keys.size();
+    for (const Key& key : keys) {
+        auto it = _cache.find(key);
+        if (it == _cache.end()) {
+            std::shared_ptr <Entry> entry = std::make_shared <Entry> (Entry{false, "", IntegratorOut()});
+            _cache.emplace(key, entry);
+            _tasks.push_back(key);
+            entries.push_back(entry);
+        } else {
+            if (it->second->done) {
+                ++_statistics.hits;
+            } else {
+                ++_statistics.coalesced;
+            }
+            entries.push_back(it->second);
+        }
+    }
+    _taskReady.notify_all();
+
+    std::vector <IntegratorOut> iOuts;
+    iOuts.reserve(keys.size());
+    for (const std::shared_ptr <Entry>& entry : entries) {
+        _resultReady.wait(lock, [&entry, this]() { return entry->done || _stopping; });
+        if (!entry->done) {
+            throw std::runtime_error("server is stopping");
+        }
+        if (!entry->error.empty()) {
+            throw std::runtime_error(entry->error);
+        }
+        iOuts.push_back(entry->iOut);
+    }
+    return iOuts;
+}
+
+std::string Server::handle(const std::string& line, bool& close) {
+    std::istringstream ss(line);
+    std::string command;
+    ss >> command;
+
+    {
+        std::lock_guard <std::mutex> lock(_mutex);
+        ++_statistics.requests;
+    }
+
+    try {
+        if (command == "cell" || command == "map") {
+            std::string R, R_b, forcingStr;
+            ss >> R >> R_b >> forcingStr;
+            const double invRe   = inverse(R);
+            const double invRe_b = inverse(R_b);
+            const int forcing    = static_cast <int> (forcingFromName(forcingStr));
+            if (forcing == static_cast <int> (Forcing::None)) {
+                return "error forcing None cannot be integrated\n";
+            }
+
+            if (command == "cell") {
+                double kxMin, kxMax, ky, kz;
+                if (!(ss >> kxMin >> kxMax >> ky >> kz) || !(kxMax > kxMin) || !(ky > 0)) {
+                    return "error usage: cell R R_b forcing kxMin kxMax ky kz with kxMax > kxMin, ky > 0\n";
+                }
+                const IntegratorOut iOut = evaluate({Key(invRe, invRe_b, forcing, kxMin, kxMax, ky, kz)}).front();
+                return (boost::format("ok %.12lg %.12lg %.12lg\n") % iOut.Ex % iOut.Ix % iOut.EInx).str();
+            }
+
+            double kxMin, dkx, kyMin, dky, kz;
+            long nx, ny;
+            if (!(ss >> kxMin >> dkx >> nx >> kyMin >> dky >> ny >> kz) || !(dkx > 0) || !(kyMin > 0) || nx < 0 ||
+                ny < 0 || !(dky >= 0)) {
+                return "error usage: map R R_b forcing kxMin dkx nx kyMin dky ny kz with dkx > 0, kyMin > 0\n";
+            }
+            // the reply holds every cell of the map, larger maps are split by the client
+            if (static_cast <double> (nx) * static_cast <double> (ny) > static_cast <double> (_cacheSize)) {
+                return (boost::format("error map of more than %d cells\n") % _cacheSize).str();
+            }
+            std::vector <Key> keys;
+            for (long j = 0; j < ny; ++j) {
+                for (long i = 0; i < nx; ++i) {
+                    const double kx = kxMin + static_cast <double> (i) * dkx;
+                    keys.push_back(Key(invRe, invRe_b, forcing, kx, kx + dkx, kyMin + static_cast <double> (j) * dky, kz));
+                }
+            }
+            const std::vector <IntegratorOut> iOuts = evaluate(keys);
+            std::string reply = (boost::format("ok %d\n") % keys.size()).str();
+            for (size_t n = 0; n < keys.size(); ++n) {
+                reply += (boost::format("%.12lg %.12lg %.12lg %.12lg %.12lg\n") % std::get <3> (keys[n]) % \
+                    std::get <5> (keys[n]) % iOuts[n].Ex % iOuts[n].Ix % iOuts[n].EInx).str();
+            }
+            return reply;
+        }
+
+        if (command == "stats") {
+            std::lock_guard <std::mutex> lock(_mutex);
+            return (boost::format("ok %d %d %d %d %d %d\n") % _statistics.requests % _statistics.cells % \
+                _statistics.hits % _statistics.coalesced % _statistics.computed % _order.size()).str();
+        }
+
+        if (command == "quit") {
+            close = true;
+            return "ok\n";
+        }
+
+        if (command == "shutdown") {
+            {
+                std::lock_guard <std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _taskReady.notify_all();
+            _resultReady.notify_all();
+            ::shutdown(_listener, SHUT_RDWR);
+            close = true;
+            return "ok\n";
+        }
+    } catch (const std::exception& e) {
+        return std::string("error ") + e.what() + "\n";
+    }
+    return "error unknown command " + command + "\n";
+}
+
+void Server::serve(int fd) {
+    std::string buffer;
+    char chunk[4096];
+    bool close = false;
+    while (!close) {
+        const ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            break;
+        }
+        buffer.append(chunk, static_cast <size_t> (n));
+        size_t end;
+        while (!close && (end = buffer.find('\n')) != std::string::npos) {
+            const std::string line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (!sendAll(fd, handle(line, close))) {
+                close = true;
+            }
+        }
+    }
+}
+
+void Server::run() {
+    _listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (_listener < 0 || _socketName.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("cannot create socket " + _socketName);
+    }
+    std::strncpy(address.sun_path, _socketName.c_str(), sizeof(address.sun_path) - 1);
+    unlink(_socketName.c_str());
+    // the socket file is created with mode 0600, so other users can neither query nor shut down the server
+    const mode_t mask = umask(0177);
+    const bool bound = (bind(_listener, reinterpret_cast <sockaddr*> (&address), sizeof(address)) == 0);
+    umask(mask);
+    if (!bound || listen(_listener, 64) < 0) {
+        ::close(_listener);
+        throw std::runtime_error("cannot listen on " + _socketName + ": " + std::strerror(errno));
+    }
+    fprintf(stdout, "Listening on %s with %d threads\n", _socketName.c_str(), _data.Nt);
+    fflush(stdout);
+
+    // connections are served by detached threads, on shutdown they are closed and waited for
+    std::set <int> clients;
+    std::mutex clientsMutex;
+    std::condition_variable clientsDone;
+    while (true) {
+        const int fd = accept(_listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        std::lock_guard <std::mutex> lock(clientsMutex);
+        clients.insert(fd);
+        std::thread([this, fd, &clients, &clientsMutex, &clientsDone]() {
+            serve(fd);
+            std::lock_guard <std::mutex> lock(clientsMutex);
+            clients.erase(fd);
+            ::close(fd);
+            clientsDone.notify_all();
+        }).detach();
+    }
+
+    std::unique_lock <std::mutex> lock(clientsMutex);
+    for (int fd : clients) {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+    clientsDone.wait(lock, [&clients]() { return clients.empty(); });
+    ::close(_listener);
+    unlink(_socketName.c_str());
+}
@@ -0,0 +1,223 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/StochasticEnsemble.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <cmath>
+
+#include "include/Affinity.h"
+#include "include/integrator.h"
+#include "include/Kernels.h"
+#include "include/LinearAlgebra.h"
+#include "include/LyapunovEquations.h"
+#include "include/Parameters.h"
+#include "include/WaveVector.h"
+
+// Philox4x32-10 counter-based generator (Salmon et al. 2011)
+inline std::array <uint32_t, 4> philox(std::array <uint32_t, 4> ctr, std::array <uint32_t, 2> key) {
+    constexpr uint64_t M0 = 0xD2511F53;
+    constexpr uint64_t M1 = 0xCD9E8D57;
+    constexpr uint32_t W0 = 0x9E3779B9;
+    constexpr uint32_t W1 = 0xBB67AE85;
+    for (int round = 0; round < 10; ++round) {
+        const uint64_t p0 = M0 * ctr[0];
+        const uint64_t p1 = M1 * ctr[2];
+        ctr = {static_cast <uint32_t> (p1 >> 32) ^ ctr[1] ^ key[0], static_cast <uint32_t> (p1),
+               static_cast <uint32_t> (p0 >> 32) ^ ctr[3] ^ key[1], static_cast <uint32_t> (p0)};
+        key[0] += W0;
+        key[1] += W1;
+    }
+    return ctr;
+}
+
+// four independent standard normal numbers for given member and step
+inline void normals(uint64_t seed, uint64_t member, uint64_t step, double xi[4]) {
+    const std::array <uint32_t, 4> r = philox(
+        {static_cast <uint32_t> (member), static_cast <uint32_t> (member >> 32),
+         static_cast <uint32_t> (step),   static_cast <uint32_t> (step >> 32)},
+        {static_cast <uint32_t> (seed),   static_cast <uint32_t> (seed >> 32)});
+    const double twoPi    = 8 * std::atan(1.0);
+    constexpr double norm = 1.0 / 4294967296.0;
+    for (int i = 0; i < 4; i += 2) {
+        const double u1 = (r[i] + 1.0) * norm;  // (0, 1]
+        const double u2 = r[i + 1] * norm;
+        const double rho = std::sqrt(-2 * std::log(u1));
+        xi[i]     = rho * std::cos(twoPi * u2);
+        xi[i + 1] = rho * std::sin(twoPi * u2);
+    }
+}
+
+StochasticEnsemble::StochasticEnsemble(const Parameters& data, const WaveVector& k, Forcing forcing, size_t nMembers,
+                                       uint64_t seed) :
+    _data(data),
+    _k(k),
+    _eq(make_equation(forcing, data, k)),
+    _nMembers(nMembers),
+    _seed(seed),
+    _u(),
+    _Ex(nMembers),
+    _Ix(nMembers),
+    _nStep(0) {
+    for (FirstTouchVector <double>& u : _u) {
+        u.resize(nMembers);
+    }
+
+    // blocks are zeroed with the same static schedule as make_step_forward() uses, so pages are local to their threads
+    const int nBlocks = static_cast <int> ((_nMembers + blockSize - 1) / blockSize);
+    setThreads(_data);
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < nBlocks; ++b) {
+        const size_t mBegin = b * blockSize;
+        const size_t mEnd   = std::min(mBegin + blockSize, _nMembers);
+        for (size_t m = mBegin; m < mEnd; ++m) {
+            _u[0][m] = 0;
+            _u[1][m] = 0;
+            _u[2][m] = 0;
+            _u[3][m] = 0;
+            _Ex[m]   = 0;
+            _Ix[m]   = 0;
+        }
+    }
+}
+
+// transition matrix of du/dt = A(t) u from t to t + dt by the classical Runge-Kutta method
+Matrix StochasticEnsemble::propagator(double t, double dt) const {
+    const Matrix I  = ublas::identity_matrix <double> (4);
+    const Matrix A0 = _eq->A(t);
+    const Matrix A1 = _eq->A(t + 0.5 * dt);
+    const Matrix A2 = _eq->A(t + dt);
+    const Matrix K1 = A0;
+    const Matrix K2 = ublas::prod(A1, Matrix(I + 0.5 * dt * K1));
+    const Matrix K3 = ublas::prod(A1, Matrix(I + 0.5 * dt * K2));
+    const Matrix K4 = ublas::prod(A2, Matrix(I + dt * K3));
+    return I + dt / 6 * (K1 + 2 * K2 + 2 * K3 + K4);
+}
+
+double StochasticEnsemble::make_step_forward(double t, double dt, bool forced, double dkx) {
+    const Matrix Phi = propagator(t, dt);
+    Matrix G = ZeroMatrix(4, 4);
+    if (forced) {
+        // covariance of the noise accumulated during the step by the trapezoid rule
+        const Matrix FFdag0 = ublas::prod(Matrix(ublas::prod(Phi, _eq->FFdag(t))), ublas::trans(Phi));
+        G = symmetricSqrt(0.5 * dt * (FFdag0 + _eq->FFdag(t + dt)));
+    }
+
+    double phi[4][4], g[4][4];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            phi[i][j] = Phi(i, j);
+            g[i][j]   = G(i, j);
+        }
+    }
+
+    const auto ensembleStep = kernels(_data.isa).ensembleStep;
+    const int nBlocks = static_cast <int> ((_nMembers + blockSize - 1) / blockSize);
+    std::vector <double> blockTrace(nBlocks, 0);
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < nBlocks; ++b) {
+        const size_t mBegin = b * blockSize;
+        const size_t mEnd   = std::min(mBegin + blockSize, _nMembers);
+        const size_t n      = mEnd - mBegin;
+
+        double dW[4][blockSize];  // standard normal numbers
+        if (forced) {
+            for (size_t m = 0; m < n; ++m) {
+                double xi[4];
+                normals(_seed, mBegin + m, _nStep, xi);
+                for (int i = 0; i < 4; ++i) {
+                    dW[i][m] = xi[i];
+                }
+            }
+        } else {
+            for (int i = 0; i < 4; ++i) {
+                std::fill(dW[i], dW[i] + n, 0.0);
+            }
+        }
+
+        blockTrace[b] = ensembleStep(n, &phi[0][0], &g[0][0], &dW[0][0], blockSize, &_u[0][mBegin], &_u[1][mBegin],
+                                     &_u[2][mBegin], &_u[3][mBegin], &_Ex[mBegin], &_Ix[mBegin], dkx);
+    }
+    ++_nStep;
+
+    // blocks are summed in fixed order to keep the result independent of the number of threads
+    double trace = 0;
+    for (double sum : blockTrace) {
+        trace += sum;
+    }
+    return trace / static_cast <double> (_nMembers);
+}
+
+double StochasticEnsemble::add_end_point(double dkx) {
+    double trace = 0;
+    for (size_t m = 0; m < _nMembers; ++m) {
+        const double E = _u[0][m] * _u[0][m] + _u[1][m] * _u[1][m] + _u[2][m] * _u[2][m] + _u[3][m] * _u[3][m];
+        _Ex[m] += E * 0.5 * dkx;
+        _Ix[m] += _u[0][m] * _u[1][m] * 0.5 * dkx;
+        trace += E;
+    }
+    return trace / static_cast <double> (_nMembers);
+}
+
+IntegratorOut StochasticEnsemble::integrateOverX(double kxMax, IntegratorOut& error) {
+    IntegratorOut iOut;
+    const double kxMin = _k.x();
+
+    double t = 0;
+    double dkx = 0;
+    const double tMax = (kxMax - kxMin) / _k.y() / _data.q;
+    bool finished = false;
+    while (finished == false) {
+        double dt = _eq->get_dt(t);
+        if (t + dt >= tMax) {
+            dt = tMax - t;
+            finished = true;
+        }
+        make_step_forward(t, dt, true, _data.q * _k.y() * dt);
+        iOut.EInx += (_eq->forsingPower(t) + _eq->forsingPower(t + dt)) * 0.5 * dt;
+        t = finished ? tMax : t + dt;
+        dkx = _data.q * _k.y() * dt;
+    }
+    add_end_point(dkx);
+    add_end_point(_data.q * _k.y() * _eq->get_dt(t));
+
+    finished = false;
+    int nSteps = 0;
+    const int nStepsMin = 10;
+    while (finished == false) {
+        const double dt = _eq->get_dt(t);
+        dkx = _data.q * _k.y() * dt;
+        const double trace = make_step_forward(t, dt, false, dkx);
+        t += dt;
+
+        finished = (_k(t).x() > std::abs(kxMin)) && (nSteps > nStepsMin) && (trace < 0.1 * iOut.EInx);
+        ++nSteps;
+    }
+    add_end_point(dkx);
+
+    // sample means and their standard errors
+    const double N = static_cast <double> (_nMembers);
+    double Ex2 = 0;
+    double Ix2 = 0;
+    for (size_t m = 0; m < _nMembers; ++m) {
+        iOut.Ex += _Ex[m] / N;
+        iOut.Ix += _Ix[m] / N;
+        Ex2 += _Ex[m] * _Ex[m] / N;
+        Ix2 += _Ix[m] * _Ix[m] / N;
+    }
+    error.Ex   = std::sqrt(std::max(Ex2 - iOut.Ex * iOut.Ex, 0.0) / N);
+    error.Ix   = std::sqrt(std::max(Ix2 - iOut.Ix * iOut.Ix, 0.0) / N);
+    error.EInx = 0;
+    return iOut;
+}
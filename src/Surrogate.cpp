@@ -0,0 +1,383 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/Surrogate.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "include/Affinity.h"
+#include "include/integrator.h"
+#include "include/Parameters.h"
+
+namespace {
+
+const char magic[8] = {'D', 'O', 'K', 'F', 'S', 'U', 'R', '2'};
+
+const double PI = std::atan(1.0) * 4;
+
+// nodes along an axis of a patch
+constexpr int maxNodes = 64;
+
+template <class T>
+void write(std::ofstream& fOut, const T& value) {
+    fOut.write(reinterpret_cast <const char*> (&value), sizeof(value));
+}
+
+template <class T>
+void read(std::ifstream& fIn, T& value) {
+    fIn.read(reinterpret_cast <char*> (&value), sizeof(value));
+}
+
+template <class T>
+void writeVector(std::ofstream& fOut, const std::vector <T>& values) {
+    const std::streamsize size = static_cast <std::streamsize> (values.size() * sizeof(T));
+    fOut.write(reinterpret_cast <const char*> (values.data()), size);
+}
+
+template <class T>
+void readVector(std::ifstream& fIn, std::vector <T>& values) {
+    const std::streamsize size = static_cast <std::streamsize> (values.size() * sizeof(T));
+    fIn.read(reinterpret_cast <char*> (values.data()), size);
+}
+
+inline double channel(const IntegratorOut& iOut, int c) {
+    return (c == 0) ? iOut.Ex : ((c == 1) ? iOut.Ix : iOut.EInx);
+}
+
+inline bool degenerate(const SurrogateBox& box, int axis) {
+    return !(box.kMax[axis] > box.kMin[axis]);
+}
+
+// j-th of n Chebyshev nodes of the first kind in [-1, 1]
+inline double chebyshevNode(int j, int n) {
+    return (n > 1) ? std::cos(PI * (j + 0.5) / n) : 0;
+}
+
+// T_0(x), ..., T_(n-1)(x)
+inline void chebyshev(double x, int n, double T[]) {
+    T[0] = 1;
+    if (n > 1) {
+        T[1] = x;
+    }
+    for (int m = 2; m < n; ++m) {
+        T[m] = 2 * x * T[m - 1] - T[m - 2];
+    }
+}
+
+/* Coefficients of the interpolant from the values at the nodes along the axis of the tensor of size n[0] x n[1] x n[2]
+   stored with the last index fastest. */
+void transform(std::vector <double>& values, const std::array <int, 3>& n, int axis) {
+    const int stride = (axis == 2) ? 1 : ((axis == 1) ? n[2] : n[1] * n[2]);
+    const int N = n[axis];
+    std::vector <double> f(N);
+    for (int i = 0; i < n[0]; ++i) {
+        for (int j = 0; j < n[1]; ++j) {
+            for (int l = 0; l < n[2]; ++l) {
+                const int index[3] = {i, j, l};
+                if (index[axis] != 0) {
+                    continue;
+                }
+                const int start = (i * n[1] + j) * n[2] + l;
+                for (int m = 0; m < N; ++m) {
+                    f[m] = values[start + m * stride];
+                }
+                for (int m = 0; m < N; ++m) {
+                    double c = 0;
+                    for (int k = 0; k < N; ++k) {
+                        c += f[k] * std::cos(PI * m * (k + 0.5) / N);
+                    }
+                    values[start + m * stride] = c * ((m == 0) ? 1.0 : 2.0) / N;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
+size_t Surrogate::nPatches() const {
+    return static_cast <size_t> (_box.patches[0]) * _box.patches[1] * _box.patches[2];
+}
+
+size_t Surrogate::patchSize() const {
+    return static_cast <size_t> (_nodes[0]) * _nodes[1] * _nodes[2];
+}
+
+size_t Surrogate::locate(const std::array <double, 3>& k, std::array <double, 3>& x) const {
+    size_t patch = 0;
+    for (int a = 0; a < 3; ++a) {
+        int p = 0;
+        x[a] = 0;
+        if (!degenerate(_box, a)) {
+            const double t = (k[a] - _box.kMin[a]) / (_box.kMax[a] - _box.kMin[a]) * _box.patches[a];
+            p = std::min(std::max(static_cast <int> (std::floor(t)), 0), _box.patches[a] - 1);
+            x[a] = std::min(std::max(2 * (t - p) - 1, -1.0), 1.0);
+        }
+        patch = patch * static_cast <size_t> (_box.patches[a]) + static_cast <size_t> (p);
+    }
+    return patch;
+}
+
+Surrogate::Surrogate(const Parameters& data, const SurrogateBox& box, double dk, int nHeldOut) :
+    _q(data.q),
+    _invRe(data.invRe),
+    _invRe_b(data.invRe_b),
+    _Ct(data.Ct),
+    _richardson(data.richardson),
+    _forcedStepper(data.forcedStepper),
+    _freeStepper(data.freeStepper),
+    _dk(dk),
+    _box(box),
+    _nodes(),
+    _errors(),
+    _coefficients() {
+    if (!(dk > 0) || box.degree < 0 || box.degree >= maxNodes) {
+        throw std::invalid_argument("Surrogate: dk must be positive and degree in [0, 63]");
+    }
+    for (int a = 0; a < 3; ++a) {
+        if (box.kMax[a] < box.kMin[a] || box.patches[a] < 1) {
+            throw std::invalid_argument("Surrogate: empty box");
+        }
+        _box.patches[a] = degenerate(box, a) ? 1 : box.patches[a];
+        _nodes[a]       = degenerate(box, a) ? 1 : box.degree + 1;
+    }
+
+    // Chebyshev nodes of all patches, then the held-out cells
+    const size_t size = patchSize();
+    std::vector <std::array <double, 3>> cells;
+    std::vector <size_t> heldOutPatch;
+    for (size_t patch = 0; patch < nPatches(); ++patch) {
+        const size_t p[3] = {patch / (_box.patches[1] * _box.patches[2]), (patch / _box.patches[2]) % _box.patches[1],
+                             patch % _box.patches[2]};
+        std::array <double, 3> lo, width;
+        for (int a = 0; a < 3; ++a) {
+            width[a] = (_box.kMax[a] - _box.kMin[a]) / _box.patches[a];
+            lo[a]    = _box.kMin[a] + static_cast <double> (p[a]) * width[a];
+        }
+        for (int i = 0; i < _nodes[0]; ++i) {
+            for (int j = 0; j < _nodes[1]; ++j) {
+                for (int l = 0; l < _nodes[2]; ++l) {
+                    const int index[3] = {i, j, l};
+                    std::array <double, 3> k;
+                    for (int a = 0; a < 3; ++a) {
+                        k[a] = lo[a] + 0.5 * (chebyshevNode(index[a], _nodes[a]) + 1) * width[a];
+                    }
+                    cells.push_back(k);
+                }
+            }
+        }
+    }
+    std::mt19937_64 random(12345);
+    std::uniform_real_distribution <double> uniform(0, 1);
+    for (size_t patch = 0; patch < nPatches(); ++patch) {
+        const size_t p[3] = {patch / (_box.patches[1] * _box.patches[2]), (patch / _box.patches[2]) % _box.patches[1],
+                             patch % _box.patches[2]};
+        for (int h = 0; h < nHeldOut; ++h) {
+            std::array <double, 3> k;
+            for (int a = 0; a < 3; ++a) {
+                const double width = (_box.kMax[a] - _box.kMin[a]) / _box.patches[a];
+                k[a] = _box.kMin[a] + (static_cast <double> (p[a]) + uniform(random)) * width;
+            }
+            cells.push_back(k);
+            heldOutPatch.push_back(patch);
+        }
+    }
+
+    const int N = static_cast <int> (cells.size());
+    std::vector <IntegratorOut> iOuts(N);
+    setThreads(data);
+    #pragma omp parallel for schedule(dynamic)
+    for (int n = 0; n < N; ++n) {
+        IntegratorOut error;
+        iOuts[n] = evaluateCell(data, cells[n][0], cells[n][0] + dk, cells[n][1], cells[n][2], error, nullptr);
+    }
+
+    _coefficients.resize(nPatches() * nChannels * size);
+    std::vector <std::array <double, nChannels>> scale(nPatches(), std::array <double, nChannels>{{0, 0, 0}});
+    for (size_t patch = 0; patch < nPatches(); ++patch) {
+        for (int c = 0; c < nChannels; ++c) {
+            std::vector <double> values(size);
+            for (size_t n = 0; n < size; ++n) {
+                values[n] = channel(iOuts[patch * size + n], c);
+                scale[patch][c] = std::max(scale[patch][c], std::abs(values[n]));
+            }
+            for (int a = 0; a < 3; ++a) {
+                transform(values, _nodes, a);
+            }
+            std::copy(values.begin(), values.end(), _coefficients.begin() + (patch * nChannels + c) * size);
+        }
+    }
+
+    _errors.assign(nPatches(), 0);
+    for (size_t h = 0; h < heldOutPatch.size(); ++h) {
+        const size_t patch = heldOutPatch[h];
+        const IntegratorOut& exact = iOuts[nPatches() * size + h];
+        double error;
+        const IntegratorOut model = evaluate(cells[nPatches() * size + h][0], cells[nPatches() * size + h][1],
+                                             cells[nPatches() * size + h][2], error);
+        for (int c = 0; c < nChannels; ++c) {
+            scale[patch][c] = std::max(scale[patch][c], std::abs(channel(exact, c)));
+        }
+        for (int c = 0; c < nChannels; ++c) {
+            if (scale[patch][c] > 0) {
+                _errors[patch] = std::max(_errors[patch],
+                                          std::abs(channel(model, c) - channel(exact, c)) / scale[patch][c]);
+            }
+        }
+    }
+}
+
+Surrogate Surrogate::load(const std::string& name) {
+    std::ifstream fIn(name, std::ios::binary);
+    char header[sizeof(magic)] = {};
+    fIn.read(header, sizeof(header));
+    if (!fIn || !std::equal(header, header + sizeof(header), magic)) {
+        throw std::runtime_error("Surrogate: " + name + " is not a surrogate model");
+    }
+
+    Surrogate s;
+    int32_t richardson, forcedStepper, freeStepper, degree;
+    std::array <int32_t, 3> patches, nodes;
+    read(fIn, s._q);
+    read(fIn, s._invRe);
+    read(fIn, s._invRe_b);
+    read(fIn, s._Ct);
+    read(fIn, richardson);
+    read(fIn, forcedStepper);
+    read(fIn, freeStepper);
+    read(fIn, s._dk);
+    read(fIn, s._box.kMin);
+    read(fIn, s._box.kMax);
+    read(fIn, patches);
+    read(fIn, degree);
+    read(fIn, nodes);
+    s._richardson = richardson;
+    s._box.degree = degree;
+    const int32_t lastStepper = static_cast <int32_t> (Stepper::Magnus);
+    if (richardson < 1 || forcedStepper < 0 || forcedStepper > lastStepper || freeStepper < 0 ||
+        freeStepper > lastStepper) {
+        throw std::runtime_error("Surrogate: " + name + " is corrupted");
+    }
+    s._forcedStepper = static_cast <Stepper> (forcedStepper);
+    s._freeStepper   = static_cast <Stepper> (freeStepper);
+    for (int a = 0; a < 3; ++a) {
+        s._box.patches[a] = patches[a];
+        s._nodes[a]       = nodes[a];
+        if (patches[a] < 1 || nodes[a] < 1 || nodes[a] > maxNodes) {
+            throw std::runtime_error("Surrogate: " + name + " is corrupted");
+        }
+    }
+    s._errors.resize(s.nPatches());
+    s._coefficients.resize(s.nPatches() * nChannels * s.patchSize());
+    readVector(fIn, s._errors);
+    readVector(fIn, s._coefficients);
+    if (!fIn) {
+        throw std::runtime_error("Surrogate: " + name + " is truncated");
+    }
+    return s;
+}
+
+void Surrogate::save(const std::string& name) const {
+    std::ofstream fOut(name, std::ios::binary);
+    fOut.write(magic, sizeof(magic));
+    write(fOut, _q);
+    write(fOut, _invRe);
+    write(fOut, _invRe_b);
+    write(fOut, _Ct);
+    write(fOut, static_cast <int32_t> (_richardson));
+    write(fOut, static_cast <int32_t> (_forcedStepper));
+    write(fOut, static_cast <int32_t> (_freeStepper));
+    write(fOut, _dk);
+    write(fOut, _box.kMin);
+    write(fOut, _box.kMax);
+    write(fOut, std::array <int32_t, 3>{{_box.patches[0], _box.patches[1], _box.patches[2]}});
+    write(fOut, static_cast <int32_t> (_box.degree));
+    write(fOut, std::array <int32_t, 3>{{_nodes[0], _nodes[1], _nodes[2]}});
+    writeVector(fOut, _errors);
+    writeVector(fOut, _coefficients);
+    if (!fOut) {
+        throw std::runtime_error("Surrogate: cannot write " + name);
+    }
+}
+
+bool Surrogate::contains(double kx, double ky, double kz) const {
+    const double k[3] = {kx, ky, kz};
+    for (int a = 0; a < 3; ++a) {
+        const double tiny = 1e-12 * std::max(1.0, std::abs(_box.kMin[a]));
+        if (k[a] < _box.kMin[a] - tiny || k[a] > _box.kMax[a] + tiny) {
+            return false;
+        }
+    }
+    return true;
+}
+
+IntegratorOut Surrogate::evaluate(double kx, double ky, double kz, double& error) const {
+    std::array <double, 3> x;
+    const size_t patch = locate({{kx, ky, kz}}, x);
+    error = _errors[patch];
+
+    double Tx[maxNodes], Ty[maxNodes], Tz[maxNodes];
+    chebyshev(x[0], _nodes[0], Tx);
+    chebyshev(x[1], _nodes[1], Ty);
+    chebyshev(x[2], _nodes[2], Tz);
+
+    double sums[nChannels];
+    const size_t size = patchSize();
+    for (int c = 0; c < nChannels; ++c) {
+        const double* coefficient = &_coefficients[(patch * nChannels + c) * size];
+        double sum = 0;
+        for (int i = 0; i < _nodes[0]; ++i) {
+            double sumY = 0;
+            for (int j = 0; j < _nodes[1]; ++j) {
+                double sumZ = 0;
+                for (int l = 0; l < _nodes[2]; ++l) {
+                    sumZ += *coefficient++ * Tz[l];
+                }
+                sumY += sumZ * Ty[j];
+            }
+            sum += sumY * Tx[i];
+        }
+        sums[c] = sum;
+    }
+
+    IntegratorOut iOut;
+    iOut.Ex   = sums[0];
+    iOut.Ix   = sums[1];
+    iOut.EInx = sums[2];
+    return iOut;
+}
+
+IntegratorOut Surrogate::query(double kx, double ky, double kz, double tolerance, bool& integrated) const {
+    double error = 0;
+    if (contains(kx, ky, kz)) {
+        const IntegratorOut iOut = evaluate(kx, ky, kz, error);
+        if (error <= tolerance) {
+            integrated = false;
+            return iOut;
+        }
+    }
+    integrated = true;
+    IntegratorOut iError;
+    return evaluateCell(parameters(), kx, kx + _dk, ky, kz, iError, nullptr);
+}
+
+Parameters Surrogate::parameters() const {
+    return Parameters(_q, _invRe, _invRe_b, _Ct, 1).withRichardson(_richardson)
+                                                     .withSteppers(_forcedStepper, _freeStepper);
+}
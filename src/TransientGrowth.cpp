@@ -0,0 +1,87 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/TransientGrowth.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "include/Affinity.h"
+#include "include/LinearAlgebra.h"
+#include "include/LyapunovEquations.h"
+#include "include/Parameters.h"
+#include "include/Progress.h"
+#include "include/WaveVector.h"
+
+std::vector <Growth> transientGrowth(const Parameters& data, const WaveVector& k, const std::vector <double>& times) {
+    StateTransitionEquation eq(data, k);
+    Matrix Phi = ublas::identity_matrix <double> (4);
+    double t = 0;
+
+    std::vector <Growth> growth;
+    growth.reserve(times.size());
+    for (double tOut : times) {
+        if (tOut > t) {
+            while (eq.make_step_forward(Phi, t, tOut) == false) {}
+        }
+
+        std::vector <double> values;
+        Matrix vectors;
+        symmetricEigen(ublas::prod(ublas::trans(Phi), Phi), values, vectors);
+        const size_t nMax = std::max_element(values.begin(), values.end()) - values.begin();
+
+        Growth g = {tOut, values[nMax], {vectors(0, nMax), vectors(1, nMax), vectors(2, nMax), vectors(3, nMax)}};
+        growth.push_back(g);
+    }
+    return growth;
+}
+
+void growthMapKyKz(const Parameters& data, std::ostream& fOut, double dk, double kyMin, double kyMax,
+                   double kzMin, double kzMax, double kxMin, double kxMax, int nOut) {
+    if (kyMin <= 0) {
+        throw std::invalid_argument("growthMapKyKz: SFH with ky <= 0 does not reach kxMax");
+    }
+    int Ny = static_cast <int> ((kyMax - kyMin) / dk) + 1;
+    int Nz = static_cast <int> ((kzMax - kzMin) / dk) + 1;
+
+    setThreads(data);
+    std::vector <Growth> optimal(Ny);
+    Progress progress(data, "Growth(ky,kz)", static_cast <uint64_t> (Ny) * Nz);
+    for (int nz = 0; nz < Nz; ++nz) {
+        const double kz = nz * dk + kzMin;
+        #pragma omp parallel for schedule(dynamic)
+        for (int ny = 0; ny < Ny; ++ny) {
+            const double ky = ny * dk + kyMin;
+            std::vector <double> times(nOut);
+            for (int n = 0; n < nOut; ++n) {
+                times[n] = (kxMax - kxMin) * (n + 1) / nOut / data.q / ky;
+            }
+            const std::vector <Growth> growth = transientGrowth(data, WaveVector(data, kxMin, ky, kz), times);
+            optimal[ny] = *std::max_element(growth.begin(), growth.end(),
+                                            [](const Growth& a, const Growth& b) { return a.G < b.G; });
+            progress.add();
+        }
+        for (int ny = 0; ny < Ny; ++ny) {
+            const double ky = ny * dk + kyMin;
+            fOut << ky                                   << "\t" \
+                 << kz                                   << "\t" \
+                 << optimal[ny].G                        << "\t" \
+                 << kxMin + data.q * ky * optimal[ny].t  << "\t" \
+                 << optimal[ny].u0[0]                    << "\t" \
+                 << optimal[ny].u0[1]                    << "\t" \
+                 << optimal[ny].u0[2]                    << "\t" \
+                 << optimal[ny].u0[3]                    << "\n";
+        }
+        fOut << std::endl;
+    }
+}
@@ -0,0 +1,223 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
+#include "include/Parameters.h"
+#include "include/LyapunovEquations.h"
+#include "include/integrator.h"
+#include "include/maps.h"
+#include "include/WaveVector.h"
+
+namespace po = boost::program_options;
+
+struct Metric {
+    std::string name;
+    double value;
+    std::string unit;
+    bool lowerIsBetter;
+};
+
+// best wall time of f() over nRepeats runs, in seconds
+template <class F>
+double measure(F f, int nRepeats) {
+    double best = std::numeric_limits <double>::max();
+    for (int i = 0; i < nRepeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration <double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+std::vector <Metric> microBenchmarks(const Parameters& data) {
+    std::vector <Metric> metrics;
+
+    const double kx = -5.0;
+    const double ky =  1.0;
+    const double kz =  0.5;
+    const WaveVector k(data, kx, ky, kz);
+
+    LyapunovEquationWithFlatForcing eq(data, k);
+    Matrix C = ZeroMatrix(4, 4);
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            C(i, j) = 1.0 / (1 + i + j);
+        }
+    }
+    Matrix dCdt(4, 4);
+
+    const int nRHS = 200000;
+    double sum = 0;
+    double time = measure([&]() {
+        for (int i = 0; i < nRHS; ++i) {
+            eq(C, dCdt, 1e-6 * i);
+            sum += dCdt(0, 1);
+        }
+    }, 5);
+    metrics.push_back({"rhs", 1e9 * time / nRHS, "ns/rhs", true});
+
+    const int nSteps = 2000;
+    time = measure([&]() {
+        Matrix CStep = ZeroMatrix(4, 4);
+        double t = 0;
+        for (int i = 0; i < nSteps; ++i) {
+            eq.make_step_forward(CStep, t);
+        }
+        sum += trace(CStep);
+    }, 5);
+    metrics.push_back({"make_step_forward", nSteps / time, "steps/s", false});
+
+    const int nSolves = 20000;
+    time = measure([&]() {
+        for (int i = 0; i < nSolves; ++i) {
+            sum += trace(eq.steady_state(1e-6 * i));
+        }
+    }, 5);
+    metrics.push_back({"steady_state", 1e9 * time / nSolves, "ns/solve", true});
+
+    IntegratorOut iOut;
+    time = measure([&]() {
+        iOut = integrateOverX(data, kx, kx + 0.1, ky, kz);
+    }, 3);
+    metrics.push_back({"integrateOverX", 1.0 / time, "cells/s", false});
+
+    // keeps the results alive so that the measured loops are not optimized out
+    std::cerr << "checksum " << sum << "\t" << iOut << std::endl;
+    return metrics;
+}
+
+std::vector <Metric> macroBenchmarks(const Parameters& data) {
+    std::vector <Metric> metrics;
+
+    // reduced versions of the SolutionMap[..] drivers, their cells are counted by the evaluator
+    const double dk = 0.5;
+    struct MapBenchmark {
+        std::string name;
+        std::function <void(const Parameters&, std::ostream&, const CellEvaluator&)> run;
+    };
+    const std::vector <MapBenchmark> maps = {
+        {"map[kx,ky]", [dk](const Parameters& d, std::ostream& os, const CellEvaluator& evaluate) {
+            mapKxKy(d, os, dk, -2, 2, 1, 1, 0, evaluate); }},
+        {"map[kx,kz]", [dk](const Parameters& d, std::ostream& os, const CellEvaluator& evaluate) {
+            mapKxKz(d, os, dk, -2, 2, 0, 0, 0.75, evaluate); }},
+        {"map[ky,kz]", [dk](const Parameters& d, std::ostream& os, const CellEvaluator& evaluate) {
+            mapKyKz(d, os, dk, 0.5, 2, 0, 0.5, evaluate); }},
+        {"relativeMap[ky,kz]", [dk](const Parameters& d, std::ostream& os, const CellEvaluator& evaluate) {
+            relativeMapKyKz(d, os, dk, 0.5, 2, 0, 0.5, evaluate); }}};
+
+    std::ostream null(nullptr);
+    for (int Nt = 1; Nt <= data.Nt; Nt *= 2) {
+        const Parameters dataNt = data.withNt(Nt);
+        for (const MapBenchmark& map : maps) {
+            std::atomic <int> nCells(0);
+            const CellEvaluator evaluate = [&nCells](const Parameters& d, double kxMin, double kxMax, double ky,
+                                                     double kz, IntegratorOut& error, CellCounters* counters) {
+                ++nCells;
+                return evaluateCell(d, kxMin, kxMax, ky, kz, error, counters);
+            };
+            double time = measure([&]() { map.run(dataNt, null, evaluate); }, 1);
+            metrics.push_back({(boost::format("%s Nt=%d") % map.name % Nt).str(), nCells / time, "cells/s", false});
+        }
+    }
+    return metrics;
+}
+
+void writeJSON(const std::string& name, const Parameters& data, const std::vector <Metric>& metrics) {
+    std::ofstream fOut;
+    fOut.open(name);
+    fOut << "{\n";
+    fOut << "  \"parameters\": \"" << data.params2Str() << "\",\n";
+    fOut << "  \"metrics\": [\n";
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        fOut << boost::format("    {\"name\": \"%s\", \"value\": %.6le, \"unit\": \"%s\", \"better\": \"%s\"}%s\n") \
+            % metrics[i].name % metrics[i].value % metrics[i].unit % (metrics[i].lowerIsBetter ? "lower" : "higher") \
+            % (i + 1 < metrics.size() ? "," : "");
+    }
+    fOut << "  ]\n";
+    fOut << "}\n";
+}
+
+// reads metrics written by writeJSON
+std::map <std::string, double> readJSON(const std::string& name) {
+    std::map <std::string, double> values;
+    std::ifstream fIn(name);
+    const std::regex metricRegex("\"name\": \"([^\"]+)\", \"value\": ([^,]+),");
+    std::string line;
+    while (std::getline(fIn, line)) {
+        std::smatch match;
+        if (std::regex_search(line, match, metricRegex)) {
+            values[match[1]] = std::stod(match[2]);
+        }
+    }
+    return values;
+}
+
+int main(int ac, char **av) {
+    std::string outputName;
+    std::string baselineName;
+    double threshold;
+
+    po::options_description options("Benchmark options");
+    options.add_options()
+     ("output",    po::value <std::string> (&outputName)   -> default_value("bench.json"), "Output JSON file")
+     ("baseline",  po::value <std::string> (&baselineName) -> default_value(""),           "Baseline JSON file")
+     ("threshold", po::value <double> (&threshold)         -> default_value(0.1),          "Allowed relative regression");
+
+    Parameters data(ac, av, options);
+    data.output();
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
+
+    // a missing baseline is written by this run, which then passes
+    std::map <std::string, double> baseline;
+    if (!baselineName.empty()) {
+        baseline = readJSON(baselineName);
+    }
+
+    std::vector <Metric> metrics = microBenchmarks(data);
+    std::vector <Metric> macro = macroBenchmarks(data);
+    metrics.insert(metrics.end(), macro.begin(), macro.end());
+    writeJSON(outputName, data, metrics);
+    if (!baselineName.empty() && baseline.empty()) {
+        writeJSON(baselineName, data, metrics);
+        fprintf(stdout, "Baseline %s is empty or not found, it is stored from this run\n", baselineName.c_str());
+    }
+
+    bool regressed = false;
+    for (const Metric& metric : metrics) {
+        fprintf(stdout, "%-28s %14.4le %-8s", metric.name.c_str(), metric.value, metric.unit.c_str());
+        auto it = baseline.find(metric.name);
+        if (it != baseline.end()) {
+            const double change = metric.lowerIsBetter ? metric.value / it->second - 1 : it->second / metric.value - 1;
+            const bool fail = change > threshold;
+            regressed = regressed || fail;
+            fprintf(stdout, " baseline %14.4le slowdown %+7.1lf%%%s", it->second, 100 * change, fail ? " REGRESSION" : "");
+        }
+        fprintf(stdout, "\n");
+    }
+
+    return regressed ? 1 : 0;
+}
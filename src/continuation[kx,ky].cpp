@@ -0,0 +1,107 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cmath>
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
+#include "include/Continuation.h"
+#include "include/Parameters.h"
+#include "include/integrator.h"
+
+namespace po = boost::program_options;
+
+int main(int ac, char **av) {
+    double RFinal;
+    double R_bFinal;
+    int nR;
+    double dk;
+    double tolerance;
+    int maxSkip;
+
+    po::options_description options("Continuation options");
+    options.add_options()
+     ("finalR",    po::value <double> (&RFinal)    -> default_value(1e5),  "Last R of the sequence, the first one is R")
+     ("finalR_b",  po::value <double> (&R_bFinal)  -> default_value(0),    "Last R_b of the sequence, 0 keeps R_b")
+     ("nR",        po::value <int>    (&nR)        -> default_value(9),    "Number of geometrically spaced points")
+     ("dk",        po::value <double> (&dk)        -> default_value(0.02), "Cell size")
+     ("tolerance", po::value <double> (&tolerance) -> default_value(1e-3), "Allowed relative error of extrapolation")
+     ("maxSkip",   po::value <int>    (&maxSkip)   -> default_value(2),    "Maximal number of skipped points in a row");
+
+    Parameters data(ac, av, options);
+    data.output();
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
+
+    const double kz    = 0;
+
+    const double kyMin = dk;
+    const double kyMax =  3;
+    const double kxMin = -20;
+    const double kxMax =  20;
+
+    const int Nx = static_cast <int> ((kxMax - kxMin) / dk);
+    const int Ny = static_cast <int> ((kyMax - kyMin) / dk) + 1;
+    std::vector <ContinuationCell> cells;
+    for (int ny = 0; ny < Ny; ++ny) {
+        for (int nx = 0; nx < Nx; ++nx) {
+            const double kx = nx * dk + kxMin;
+            cells.push_back({kx, kx + dk, ny * dk + kyMin, kz});
+        }
+    }
+
+    // 1 / R and 1 / R_b are spaced geometrically, infinite R_b stays infinite
+    // the spacing is in ln 1 / R, so both ends must be finite (compared explicitly, -ffast-math drops isfinite)
+    if (!(data.invRe > 0) || !(RFinal > 0) || !(RFinal < std::numeric_limits <double>::max())) {
+        throw std::invalid_argument("continuation needs finite --R and --finalR");
+    }
+    const double invReFinal   = 1.0 / RFinal;
+    const double invRe_bFinal = (R_bFinal > 0) ? 1.0 / R_bFinal : data.invRe_b;
+    Continuation continuation(data, cells, tolerance, maxSkip);
+    for (int n = 0; n < nR; ++n) {
+        const double w = (nR > 1) ? static_cast <double> (n) / (nR - 1) : 0;
+        const double invRe   = data.invRe * std::pow(invReFinal / data.invRe, w);
+        const double invRe_b = (data.invRe_b > 0 && invRe_bFinal > 0) ?
+                               data.invRe_b * std::pow(invRe_bFinal / data.invRe_b, w) : invRe_bFinal * w;
+
+        const std::vector <IntegratorOut>& iOuts = continuation.step(invRe, invRe_b);
+
+        std::stringstream mapName;
+        mapName << boost::format("./map/Continuation(kx,ky) R = %.0le R_b = %.0le dk = %.2lf kz = %.1lf") \
+            % (1.0 / invRe) % (1.0 / invRe_b) % dk % kz;
+        std::ofstream fOut;
+        fOut.open(mapName.str());
+        size_t nComputed = 0;
+        for (int ny = 0; ny < Ny; ++ny) {
+            for (int nx = 0; nx < Nx; ++nx) {
+                const size_t i = static_cast <size_t> (ny) * Nx + nx;
+                fOut << cells[i].kxMin  << "\t" \
+                     << cells[i].ky     << "\t" \
+                     << iOuts[i].Ex     << "\t" \
+                     << iOuts[i].Ix     << "\t" \
+                     << iOuts[i].EInx   << "\n";
+                nComputed += continuation.computed(i);
+            }
+            fOut << std::endl;
+        }
+        fOut.close();
+        fprintf(stdout, "R = %.3le R_b = %.3le computed %zu of %zu cells\n",
+                1.0 / invRe, 1.0 / invRe_b, nComputed, cells.size());
+    }
+    return 0;
+}
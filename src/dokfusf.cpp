@@ -0,0 +1,226 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/dokfusf.h"
+
+#include <omp.h>
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "include/integrator.h"
+#include "include/LyapunovEquations.h"
+#include "include/Parameters.h"
+#include "include/Surrogate.h"
+
+struct dokfusf_surrogate {
+    Surrogate surrogate;
+};
+
+namespace {
+
+constexpr Forcing forcings[] = {Forcing::Flat, Forcing::Flat2D, Forcing::White2D, Forcing::White3D,
+                                Forcing::VorticalWhite2D, Forcing::SoundWhite2D, Forcing::None};
+constexpr int nForcings = sizeof(forcings) / sizeof(forcings[0]);
+
+bool valid(const dokfusf_parameters* data) {
+    return data != nullptr && data->q > 0 && data->invRe >= 0 && data->invRe_b >= 0 && data->Ct > 0 &&
+           data->Nt > 0 && data->richardson > 0;
+}
+
+bool valid(dokfusf_forcing forcing) {
+    return forcing >= 0 && forcing < nForcings;
+}
+
+// without forcing C stays zero and the free phase never meets its stopping condition trace(C) < 0.1 EInx
+bool integrable(dokfusf_forcing forcing) {
+    return valid(forcing) && forcings[forcing] != Forcing::None;
+}
+
+Parameters parameters(const dokfusf_parameters* data) {
+    return Parameters(data->q, data->invRe, data->invRe_b, data->Ct, data->Nt);
+}
+
+dokfusf_result result(const IntegratorOut& iOut) {
+    return {iOut.Ex, iOut.Ix, iOut.EInx};
+}
+
+// exceptions must not cross the C interface
+template <class F>
+int guarded(F f) {
+    try {
+        f();
+        return DOKFUSF_OK;
+    } catch (const std::invalid_argument&) {
+        return DOKFUSF_INVALID_ARGUMENT;
+    } catch (const std::exception&) {
+        return DOKFUSF_NUMERICAL_ERROR;
+    } catch (...) {
+        return DOKFUSF_INTERNAL_ERROR;
+    }
+}
+
+// cell(i) returns status of i-th cell, the first error is returned
+template <class Cell>
+int parallelCells(const dokfusf_parameters* data, size_t n, Cell cell) {
+    int status = DOKFUSF_OK;
+    const long N = static_cast <long> (n);
+    #pragma omp parallel for schedule(dynamic) num_threads(data->Nt)
+    for (long i = 0; i < N; ++i) {
+        const int cellStatus = cell(static_cast <size_t> (i));
+        if (cellStatus != DOKFUSF_OK) {
+            #pragma omp critical(dokfusfStatus)
+            if (status == DOKFUSF_OK) {
+                status = cellStatus;
+            }
+        }
+    }
+    return status;
+}
+
+}  // namespace
+
+int dokfusf_abi_version(void) {
+    return DOKFUSF_ABI_VERSION;
+}
+
+void dokfusf_default_parameters(dokfusf_parameters* data) {
+    if (data != nullptr) {
+        *data = {1.5, 0, 0, 0.1, 1, 1};
+    }
+}
+
+const char* dokfusf_forcing_name(dokfusf_forcing forcing) {
+    static const std::string names[] = {forcingName(Forcing::Flat), forcingName(Forcing::Flat2D),
+                                        forcingName(Forcing::White2D), forcingName(Forcing::White3D),
+                                        forcingName(Forcing::VorticalWhite2D), forcingName(Forcing::SoundWhite2D),
+                                        forcingName(Forcing::None)};
+    return valid(forcing) ? names[forcing].c_str() : nullptr;
+}
+
+int dokfusf_forcing_from_name(const char* name, dokfusf_forcing* forcing) {
+    if (name == nullptr || forcing == nullptr) {
+        return DOKFUSF_INVALID_ARGUMENT;
+    }
+    return guarded([&]() {
+        const Forcing f = forcingFromName(name);
+        for (int n = 0; n < nForcings; ++n) {
+            if (forcings[n] == f) {
+                *forcing = static_cast <dokfusf_forcing> (n);
+            }
+        }
+    });
+}
+
+int dokfusf_integrate_over_x(const dokfusf_parameters* data, double kxMin, double kxMax, double ky, double kz,
+                             dokfusf_forcing forcing, dokfusf_result* result, dokfusf_result* error) {
+    if (!valid(data) || !integrable(forcing) || result == nullptr || !(kxMax > kxMin) || !(ky > 0)) {
+        return DOKFUSF_INVALID_ARGUMENT;
+    }
+    return guarded([&]() {
+        IntegratorOut iError;
+        *result = ::result(extrapolateOverX(parameters(data), kxMin, kxMax, ky, kz, forcings[forcing],
+                                            data->richardson, iError));
+        if (error != nullptr) {
+            *error = ::result(iError);
+        }
+    });
+}
+
+int dokfusf_integrate_gradient(const dokfusf_parameters* data, double kxMin, double kxMax, double ky, double kz,
+                               dokfusf_forcing forcing, dokfusf_result* result, dokfusf_result gradient[4]) {
+    if (!valid(data) || !integrable(forcing) || result == nullptr || gradient == nullptr || !(kxMax > kxMin) ||
+        !(ky > 0)) {
+        return DOKFUSF_INVALID_ARGUMENT;
+    }
+    return guarded([&]() {
+        const std::vector <Sensitivity> sensitivities = {Sensitivity::Kx, Sensitivity::Ky, Sensitivity::Kz,
+                                                         Sensitivity::R};
+        std::vector <IntegratorOut> iGradient;
+        *result = ::result(integrateOverX(parameters(data), kxMin, kxMax, ky, kz, forcings[forcing], sensitivities,
+                                          iGradient));
+        for (size_t n = 0; n < sensitivities.size(); ++n) {
+            gradient[n] = ::result(iGradient[n]);
+        }
+    });
+}
+
+int dokfusf_integrate_cells(const dokfusf_parameters* data, size_t n, const double* kxMin, const double* kxMax,
+                            const double* ky, const double* kz, dokfusf_forcing forcing,
+                            dokfusf_result* results, dokfusf_result* errors) {
+    if (!valid(data) || !integrable(forcing) || (n > 0 && (kxMin == nullptr || kxMax == nullptr || ky == nullptr ||
+                                                      kz == nullptr || results == nullptr))) {
+        return DOKFUSF_INVALID_ARGUMENT;
+    }
+    dokfusf_parameters single = *data;
+    single.Nt = 1;
+    return parallelCells(data, n, [&](size_t i) {
+        return dokfusf_integrate_over_x(&single, kxMin[i], kxMax[i], ky[i], kz[i], forcing, &results[i],
+                                        errors != nullptr ? &errors[i] : nullptr);
+    });
+}
+
+int dokfusf_map_kx_ky(const dokfusf_parameters* data, size_t nx, double kxMin, double dkx, size_t ny, double kyMin,
+                      double dky, double kz, dokfusf_forcing forcing, dokfusf_result* results, dokfusf_result* errors) {
+    if (!valid(data) || !integrable(forcing) || !(dkx > 0) || !(kyMin > 0) || !(dky >= 0) ||
+        (nx * ny > 0 && results == nullptr)) {
+        return DOKFUSF_INVALID_ARGUMENT;
+    }
+    const Parameters parametersData = parameters(data);
+    return parallelCells(data, nx * ny, [&](size_t i) {
+        return guarded([&]() {
+            const double kx = kxMin + static_cast <double> (i % nx) * dkx;
+            const double ky = kyMin + static_cast <double> (i / nx) * dky;
+            IntegratorOut iError;
+            results[i] = result(extrapolateOverX(parametersData, kx, kx + dkx, ky, kz, forcings[forcing],
+                                                 data->richardson, iError));
+            if (errors != nullptr) {
+                errors[i] = result(iError);
+            }
+        });
+    });
+}
+
+int dokfusf_surrogate_load(const char* name, dokfusf_surrogate** surrogate) {
+    if (name == nullptr || surrogate == nullptr) {
+        return DOKFUSF_INVALID_ARGUMENT;
+    }
+    *surrogate = nullptr;
+    const int status = guarded([&]() {
+        *surrogate = new dokfusf_surrogate{Surrogate::load(name)};
+    });
+    // a file that is not a model is an invalid argument rather than a numerical error
+    return (status == DOKFUSF_NUMERICAL_ERROR) ? DOKFUSF_INVALID_ARGUMENT : status;
+}
+
+void dokfusf_surrogate_free(dokfusf_surrogate* surrogate) {
+    delete surrogate;
+}
+
+int dokfusf_surrogate_evaluate(const dokfusf_surrogate* surrogate, double kx, double ky, double kz, double tolerance,
+                               dokfusf_result* result, double* error, int* integrated) {
+    if (surrogate == nullptr || result == nullptr || !(ky > 0)) {
+        return DOKFUSF_INVALID_ARGUMENT;
+    }
+    return guarded([&]() {
+        bool isIntegrated = false;
+        *result = ::result(surrogate->surrogate.query(kx, ky, kz, tolerance, isIntegrated));
+        if (error != nullptr) {
+            *error = 0;
+            if (surrogate->surrogate.contains(kx, ky, kz)) {
+                surrogate->surrogate.evaluate(kx, ky, kz, *error);
+            }
+        }
+        if (integrated != nullptr) {
+            *integrated = isIntegrated ? 1 : 0;
+        }
+    });
+}
@@ -0,0 +1,50 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "include/Parameters.h"
+#include "include/Server.h"
+
+namespace po = boost::program_options;
+
+int main(int ac, char **av) {
+    std::string socketName;
+    size_t cacheSize;
+
+    po::options_description options("Server options");
+    options.add_options()
+     ("serve",     po::value <std::string> (&socketName) -> default_value(""),      "Unix domain socket to listen on")
+     ("cacheSize", po::value <size_t>      (&cacheSize)  -> default_value(1000000), "Maximal number of cached cells");
+
+    Parameters data(ac, av, options);
+    data.output();
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
+
+    if (socketName.empty()) {
+        std::cerr << options << std::endl;
+        return 1;
+    }
+
+    try {
+        Server server(data, socketName, cacheSize);
+        server.run();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include <omp.h>
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include <boost/program_options.hpp>
+
+#include "include/Parameters.h"
+#include "include/WaveVector.h"
+#include "include/integrator.h"
+#include "include/StochasticEnsemble.h"
+#include "include/validation.h"
+
+namespace po = boost::program_options;
+
+int main(int ac, char **av) {
+    std::string referenceName;
+    int nMembers;
+    int seed;
+
+    po::options_description options("Ensemble options");
+    options.add_options()
+     ("reference", po::value <std::string> (&referenceName) -> default_value("./configs/reference.dat"), "Reference file")
+     ("members",   po::value <int> (&nMembers)              -> default_value(10000), "Number of realizations")
+     ("seed",      po::value <int> (&seed)                  -> default_value(1),     "Seed of random numbers");
+
+    Parameters data(ac, av, options);
+    data.output();
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
+
+    const std::vector <ValidationCase> cases = readReference(referenceName);
+    if (cases.empty()) {
+        fprintf(stderr, "Reference %s is empty or not found\n", referenceName.c_str());
+        return 1;
+    }
+
+    fprintf(stdout, "%-16s %12s %22s %8s %12s %22s %8s %8s\n",
+            "forcing", "Ex", "Ex (SDE)", "z", "Ix", "Ix (SDE)", "z", "time, s");
+    for (const ValidationCase& c : cases) {
+        const Parameters caseData = c.parameters(data);
+        const double start = omp_get_wtime();
+        StochasticEnsemble ensemble(caseData, WaveVector(caseData, c.kxMin, c.ky, c.kz), c.forcing,
+                                    static_cast <size_t> (nMembers), static_cast <uint64_t> (seed));
+        IntegratorOut error;
+        const IntegratorOut iOut = ensemble.integrateOverX(c.kxMax, error);
+        const double time = omp_get_wtime() - start;
+
+        fprintf(stdout, "%-16s %12.5lg %12.5lg+-%-8.2lg %8.2lf %12.5lg %12.5lg+-%-8.2lg %8.2lf %8.2lf\n",
+                forcingName(c.forcing).c_str(),
+                c.reference.Ex, iOut.Ex, error.Ex, (iOut.Ex - c.reference.Ex) / error.Ex,
+                c.reference.Ix, iOut.Ix, error.Ix, (iOut.Ix - c.reference.Ix) / error.Ix, time);
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include <omp.h>
+
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "include/Affinity.h"
+#include "include/Parameters.h"
+#include "include/LyapunovEquations.h"
+#include "include/integrator.h"
+#include "include/WaveVector.h"
+
+
+int main(int ac, char **av) {
+    Parameters data(ac, av);
+    data.output();
+
+    const double ky    =  1.0;
+    const double kz    =  0.0;
+
+    const double dk    =  0.1;
+    const double kxMin = -20;
+    const double kxMax =  20;
+
+    const std::vector <Forcing> forcings = {Forcing::Flat,
+                                            Forcing::White2D,
+                                            Forcing::White3D,
+                                            Forcing::VorticalWhite2D,
+                                            Forcing::SoundWhite2D};
+
+    int Nx = static_cast <int> ((kxMax - kxMin) / dk);
+
+    std::stringstream name;
+    name << boost::format("E(kx) ForcingComparison R = %.0le R_b = %.0le dk = %.2lf ky = %.2lf kz = %.2lf") \
+        % (1.0 / data.invRe) % (1.0 / data.invRe_b) % dk % ky % kz;
+    std::ofstream fOut;
+    fOut.open(name.str());
+
+    setThreads(data);
+    std::vector <std::vector <IntegratorOut>> iOuts(Nx);
+    #pragma omp parallel for schedule(dynamic)
+    for (int nx = 0; nx < Nx; ++nx) {
+        const double kx = nx * dk + kxMin;
+        iOuts[nx] = integrateOverX(data, kx, kx + dk, ky, kz, forcings);
+    }
+
+    for (int nx = 0; nx < Nx; ++nx) {
+        fOut << nx * dk + kxMin;
+        for (const IntegratorOut& iOut : iOuts[nx]) {
+            fOut << "\t" << iOut;
+        }
+        fOut << "\n";
+    }
+    fOut.close();
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "Parameters.h"
+
+// number of sockets (physical packages) among CPUs available to the process
+int nSockets();
+
+// socket of the logical CPU, 0 if the topology is unknown
+int socketOfCpu(int cpu);
+
+// socket of the calling thread as resolved by setThreads(), threads outside of it resolve their socket at first call
+int currentSocket();
+
+/* Sets data.Nt OpenMP threads and, unless data.affinity is None, binds thread n to the n-th CPU of the placement:
+   compact fills sockets one after another, spread alternates between sockets. Threads of the OpenMP pool keep their
+   CPUs in later parallel regions of the same size. Every thread of the pool caches its socket for currentSocket(). */
+void setThreads(const Parameters& data);
+
+// gives the calling thread all CPUs of the process back, e.g. for a helper thread created by a bound thread
+void unbindThread();
+
+/* Allocator which leaves elements of trivial types uninitialized, so the pages of a large buffer are first touched
+   (and placed on the NUMA node of) the threads which initialize it in a parallel loop. */
+template <class T>
+class UninitializedAllocator : public std::allocator <T> {
+ public:
+    template <class U>
+    struct rebind {
+        typedef UninitializedAllocator <U> other;
+    };
+
+    UninitializedAllocator() = default;
+
+    template <class U>
+    UninitializedAllocator(const UninitializedAllocator <U>&) {}
+
+    template <class U>
+    void construct(U* p) {
+        ::new(static_cast <void*> (p)) U;
+    }
+
+    template <class U, class... Args>
+    void construct(U* p, Args&&... args) {
+        ::new(static_cast <void*> (p)) U(std::forward <Args> (args)...);
+    }
+};
+
+template <class T>
+using FirstTouchVector = std::vector <T, UninitializedAllocator <T>>;
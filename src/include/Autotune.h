@@ -0,0 +1,23 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <cstddef>
+
+#include "Figures.h"
+#include "Parameters.h"
+
+/* Choice of the integrator for the cells of figure. The cells are recorded by a run of figure without output and
+   nSamples of them spread over |k| are integrated with the reference Courant constant. Every candidate configuration
+   (Ct, Richardson levels, steppers, the one of data first) is timed on the samples, the cheapest one with relative
+   errors of Ex, Ix and EInx within data.autotune is returned, the most accurate one if none meets it. The table of
+   candidates is written to stdout. data is returned unchanged if data.autotune is 0 or the figure has no more than
+   nSamples cells. */
+Parameters autotune(const Parameters& data, const Figure& figure, size_t nSamples = 8, double referenceCt = 1e-3);
@@ -0,0 +1,70 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "integrator.h"
+#include "Parameters.h"
+
+// Cell of integrateOverX
+struct ContinuationCell {
+ public:
+    double kxMin;
+    double kxMax;
+    double ky;
+    double kz;
+};
+
+/* Continuation of cells along sequence of (1 / R, 1 / R_b). For every cell the last three computed results are kept
+   and the next one is predicted by quadratic extrapolation in s = (ln 1 / R, ln 1 / R_b,eff). When the prediction of
+   the last computed point was within tolerance and the quadratic prediction of the new point differs from the linear
+   one through the last two results by less than tolerance, the cell is skipped and the prediction is used instead,
+   but not more than maxSkip times in a row. Only the results are predicted, every computed cell is integrated from
+   scratch. R must be finite, R_b may be infinite. */
+class Continuation {
+ private:
+    struct History {
+     public:
+        int n;
+        std::array <double, 3> s;
+        std::array <IntegratorOut, 3> iOut;
+        double error;  // relative error of the last checked prediction, raised by the estimates of skipped points
+        int nSkipped;
+        bool computed;
+    };
+
+    const Parameters _data;
+    const std::vector <ContinuationCell> _cells;
+    const double _tolerance;
+    const int _maxSkip;
+
+    std::vector <History> _history;
+    std::vector <IntegratorOut> _iOuts;
+    double _s;
+    double _x;
+    double _y;
+    bool _first;
+
+    // extrapolation to s through the points first, ..., h.n - 1 of the history
+    IntegratorOut predict(const History& h, double s, int first) const;
+
+ public:
+    Continuation(const Parameters& data, const std::vector <ContinuationCell>& cells, double tolerance, int maxSkip);
+
+    // results for the next point of the sequence, cells are integrated in parallel
+    const std::vector <IntegratorOut>& step(double invRe, double invRe_b);
+
+    // false if the cell was taken from extrapolation at the last step
+    inline bool computed(size_t n) const {
+        return _history[n].computed;
+    }
+};
@@ -0,0 +1,43 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "integrator.h"
+#include "Parameters.h"
+
+// integrand node of cubature()
+struct CubatureNode {
+ public:
+    double ky;
+    double kz;
+    IntegratorOut iOut;
+};
+
+struct CubatureOut {
+ public:
+    IntegratorOut integral;
+    IntegratorOut error;   // sum of the error estimates of the regions, absolute values
+    std::vector <CubatureNode> nodes;
+
+    CubatureOut() : integral(), error(), nodes() {}
+};
+
+/* Adaptive cubature of f over [kyMin, kyMax] x [kzMin, kzMax]. Every region is integrated by the tensor Simpson rule on
+   its 5 x 5 nodes, improved by Richardson extrapolation from the 3 x 3 subgrid, which also gives the error estimate.
+   Regions with the largest errors are bisected along the axis with the larger error. The rule is nested, so children
+   reuse 15 of their 25 nodes and every node is evaluated once. Refinement stops when the sum of the errors of Ex, Ix
+   and EInx relative to the integral is below tolerance, or no region can be split further. New nodes of every
+   refinement are evaluated in parallel over data.Nt threads. */
+CubatureOut cubature(const Parameters& data, const std::function <IntegratorOut(double ky, double kz)>& f,
+                     double kyMin, double kyMax, double kzMin, double kzMax, double tolerance);
@@ -0,0 +1,85 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Instrumentation.h"
+#include "integrator.h"
+#include "Parameters.h"
+
+/* Figures of the paper. Every figure writes the files of its driver and gets cells from evaluate, nothing is written
+   if output is false. */
+
+void solutionMapKxKy(const Parameters& data, const CellEvaluator& evaluate = evaluateCell, bool output = true);
+
+void solutionMapKxKz(const Parameters& data, const CellEvaluator& evaluate = evaluateCell, bool output = true);
+
+void solutionMapKyKz(const Parameters& data, const CellEvaluator& evaluate = evaluateCell, bool output = true);
+
+void solutionRelativeMapKyKz(const Parameters& data, const CellEvaluator& evaluate = evaluateCell, bool output = true);
+
+void optimalR(const Parameters& data, const CellEvaluator& evaluate = evaluateCell, bool output = true);
+
+void spectraKyKz(const Parameters& data, const CellEvaluator& evaluate = evaluateCell, bool output = true);
+
+typedef std::function <void(const Parameters&, const CellEvaluator&, bool)> Figure;
+
+// figures by the names of their make targets
+const std::map <std::string, Figure>& figures();
+
+/* Cells shared by several figures. Figures are run first with record() as evaluator and without output, then distinct
+   cells are integrated together in parallel by run() and the figures are run again with lookup(). */
+class CellPool {
+ private:
+    // (1 / R, 1 / R_b, Ct, richardson, kxMin, kxMax, ky, kz), q is the same for all cells
+    typedef std::tuple <double, double, double, int, double, double, double, double> Key;
+
+    struct Cell {
+     public:
+        IntegratorOut iOut;
+        IntegratorOut error;
+    };
+
+    std::mutex _mutex;
+    std::map <Key, Cell> _cells;
+    size_t _requested;
+
+    static Key key(const Parameters& data, double kxMin, double kxMax, double ky, double kz);
+
+    static Cell integrate(const Parameters& data, const Key& k);
+
+ public:
+    CellPool() : _mutex(), _cells(), _requested(0) {}
+
+    IntegratorOut record(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                         IntegratorOut& error, CellCounters* counters);
+
+    // cells are integrated over data.Nt threads
+    void run(const Parameters& data);
+
+    // cells missing from the pool are integrated on the calling thread and added to it, lookup() may be called from
+    // several threads
+    IntegratorOut lookup(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                         IntegratorOut& error, CellCounters* counters);
+
+    inline size_t requested() const {
+        return _requested;
+    }
+
+    inline size_t size() const {
+        return _cells.size();
+    }
+};
@@ -0,0 +1,135 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <omp.h>
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+#include "Parameters.h"
+
+// Work done by the integrator during one phase (forced or free decay) of the SFH
+struct PhaseCounters {
+ public:
+    uint64_t rhs;       // right-hand side evaluations
+    uint64_t accepted;  // accepted Runge-Kutta steps
+    uint64_t rejected;  // rejected Runge-Kutta steps
+    uint64_t steps;     // calls of make_step_forward
+    double time;        // wall time, s
+
+    constexpr PhaseCounters() : rhs(0), accepted(0), rejected(0), steps(0), time(0) {}
+
+    PhaseCounters& operator += (const PhaseCounters& rhs) {
+        this->rhs += rhs.rhs;
+        accepted  += rhs.accepted;
+        rejected  += rhs.rejected;
+        steps     += rhs.steps;
+        time      += rhs.time;
+
+        return *this;
+    }
+
+    friend std::ostream& operator << (std::ostream& os, const PhaseCounters& c) {
+        os << c.rhs << "\t" << c.accepted << "\t" << c.rejected << "\t" << c.steps << "\t" << c.time;
+        return os;
+    }
+};
+
+struct CellCounters {
+ public:
+    PhaseCounters forced;
+    PhaseCounters free;
+
+    constexpr CellCounters() : forced(), free() {}
+
+    CellCounters& operator += (const CellCounters& rhs) {
+        forced += rhs.forced;
+        free   += rhs.free;
+
+        return *this;
+    }
+
+    friend std::ostream& operator << (std::ostream& os, const CellCounters& c) {
+        os << c.forced << "\t" << c.free;
+        return os;
+    }
+};
+
+/* Side-car file of a map with CellCounters of every cell, written in the same order as the map itself.
+   Totals of every thread are appended at the end. Does nothing if data.counters is empty. Callers which keep the
+   counters of their cells themselves construct it with nCells = 0 and pass the counters to add() and output(). */
+class CountersOutput {
+ private:
+    const bool _enabled;
+    std::ofstream _fOut;
+    std::vector <CellCounters> _cells;
+    std::vector <CellCounters> _threads;
+
+ public:
+    CountersOutput(const Parameters& data, int nCells) :
+        _enabled(!data.counters.empty()),
+        _fOut(),
+        _cells(_enabled ? nCells : 0),
+        _threads(_enabled ? data.Nt : 0) {
+        if (_enabled) {
+            _fOut.open(data.counters);
+            _fOut << "# k1\tk2\tforced: rhs accepted rejected steps time\tfree: rhs accepted rejected steps time\n";
+        }
+    }
+
+    inline bool enabled() const {
+        return _enabled;
+    }
+
+    inline CellCounters* cell(int n) {
+        return _enabled ? &_cells[n] : nullptr;
+    }
+
+    // must be called by the thread which computed the cell
+    inline void add(const CellCounters& counters) {
+        if (_enabled) {
+            _threads[omp_get_thread_num() % _threads.size()] += counters;
+        }
+    }
+
+    inline void add(int n) {
+        if (_enabled) {
+            add(_cells[n]);
+        }
+    }
+
+    inline void output(double k1, double k2, const CellCounters& counters) {
+        if (_enabled) {
+            _fOut << k1 << "\t" << k2 << "\t" << counters << "\n";
+        }
+    }
+
+    inline void output(int n, double k1, double k2) {
+        if (_enabled) {
+            output(k1, k2, _cells[n]);
+            _cells[n] = CellCounters();
+        }
+    }
+
+    inline void endRow() {
+        if (_enabled) {
+            _fOut << std::endl;
+        }
+    }
+
+    ~CountersOutput() {
+        for (size_t i = 0; i < _threads.size(); ++i) {
+            _fOut << "# thread " << i << "\t" << _threads[i] << "\n";
+        }
+    }
+};
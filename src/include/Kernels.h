@@ -0,0 +1,34 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <cstddef>
+
+#include "Parameters.h"
+
+/* Hot numerical kernels compiled for several instruction sets in one binary. The variant is picked at run time from
+   CPUID, so binaries built with the portable baseline run at full speed on every generation of CPUs. */
+struct Kernels {
+    Isa isa;
+
+    // dCdt = Q + A C + (A C)^T for symmetric C, all matrices are 4 x 4 stored by rows
+    void (*lyapunovRhs)(const double* A, const double* C, const double* Q, double* dCdt);
+
+    // c = a b for n x n matrices stored by rows
+    void (*multiply)(int n, const double* a, const double* b, double* c);
+
+    /* u = phi u + g dW for n members stored as structure of arrays u0, ..., u3, dW has 4 rows with stride; trapezoid
+       dkx-integrals of u^2 and u0 u1 are added to Ex and Ix. Returns the sum of u^2 after the step. */
+    double (*ensembleStep)(size_t n, const double* phi, const double* g, const double* dW, size_t stride,
+                           double* u0, double* u1, double* u2, double* u3, double* Ex, double* Ix, double dkx);
+};
+
+// kernels for isa, Isa::Auto gives the best one supported by the CPU; throws std::runtime_error if it is not supported
+const Kernels& kernels(Isa isa);
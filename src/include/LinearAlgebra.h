@@ -0,0 +1,22 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <vector>
+
+#include "LyapunovEquations.h"
+
+// Dense linear algebra for the small matrices of the problem
+
+// eigenvalues and eigenvectors (columns of vectors) of symmetric matrix S by the cyclic Jacobi method
+void symmetricEigen(const Matrix& S, std::vector <double>& values, Matrix& vectors);
+
+// symmetric square root of symmetric positive semi-definite matrix, negative eigenvalues are treated as zero
+Matrix symmetricSqrt(const Matrix& S);
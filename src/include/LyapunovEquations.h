@@ -9,8 +9,16 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
 #pragma once
 
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <boost/numeric/ublas/matrix.hpp>
 
+#include "Instrumentation.h"
+#include "Kernels.h"
 #include "Parameters.h"
 #include "WaveVector.h"
 
@@ -28,22 +36,92 @@ inline double get_flux(const Matrix& C) {
     return C(0, 1);
 }
 
+// n-th 4x4 covariance of the stacked state 4 x 4N used by LyapunovEquationWithMultipleForcing
+inline double trace(const Matrix& C, size_t n) {
+    return C(0, 4 * n) + C(1, 4 * n + 1) + C(2, 4 * n + 2) + C(3, 4 * n + 3);
+}
+
+inline double get_flux(const Matrix& C, size_t n) {
+    return C(0, 4 * n + 1);
+}
+
+// gets a moment and the state at it, returns false to stop the integration
+typedef std::function <bool(double, const Matrix&)> Observer;
+
+// dissipative terms of A(t): none, viscosity with its bulk part 1 / (3 R), viscosity with bulk viscosity 1 / R_b
+enum class Regime {
+    Inviscid,
+    Viscous,
+    BulkViscous
+};
+
+enum class Forcing {
+    Flat,
+    Flat2D,
+    White2D,
+    White3D,
+    VorticalWhite2D,
+    SoundWhite2D,
+    None
+};
+
+/* Solution of algebraic Lyapunov equation A C + C A^T + Q = 0 for symmetric Q. Symmetry of C leaves 10 unknowns,
+   which are found by Gaussian elimination. Throws std::runtime_error if A has eigenvalues with zero sum. */
+Matrix solveLyapunov(const Matrix& A, const Matrix& Q);
+
+std::string forcingName(Forcing forcing);
+
+// throws std::invalid_argument for unknown names
+Forcing forcingFromName(const std::string& name);
+
+// parameters of forward sensitivities, kx shifts the whole cell [kxMin, kxMax], R enters A(t) through 1 / R
+enum class Sensitivity {
+    Kx,
+    Ky,
+    Kz,
+    R
+};
+
+std::string sensitivityName(Sensitivity parameter);
+
+// throws std::invalid_argument for unknown names
+Sensitivity sensitivityFromName(const std::string& name);
+
 class AbstractLyapunovEquation {
  private:
     const double _q;
     const double _invRe;
     const double _invRe_b;
     const double _Ct;
+    const Regime _regime;
+    const Kernels& _kernels;
 
-    Matrix A(double t) const;
+    virtual Matrix FFdag(double t) const = 0;
 
-    Matrix Adag(double t) const;
+    static Regime regime(const Parameters& data);
 
-    virtual Matrix FFdag(double t) const = 0;
+    // kernels specialized for the regime at compile time, dissipative terms of other regimes are not evaluated
+    template <Regime regime>
+    void fillA(double a[4][4], double t) const;
+
+    template <Regime regime>
+    double dt(double t) const;
+
+    template <Regime regime>
+    void rhs(const Matrix& C, Matrix& dCdt, double t) const;
+
+    friend class LyapunovEquationWithMultipleForcing;
+    friend class TangentLinearEquation;
+    friend class StochasticEnsemble;
+    friend class MagnusPropagator;
 
  protected:
     const WaveVector _k;
 
+    PhaseCounters* _counters;
+
+    Matrix A(double t) const;
+
     static constexpr int x = 0;
     static constexpr int y = 1;
     static constexpr int z = 2;
@@ -57,16 +135,41 @@ class AbstractLyapunovEquation {
         _invRe(data.invRe),
         _invRe_b(data.invRe_b + data.invRe / 3.0),
         _Ct(data.Ct),
-        _k(k) {}
+        _regime(regime(data)),
+        _kernels(kernels(data.isa)),
+        _k(k),
+        _counters(nullptr) {}
+
+    AbstractLyapunovEquation(const AbstractLyapunovEquation&) = default;
+
+    AbstractLyapunovEquation& operator = (const AbstractLyapunovEquation&) = delete;
+
+    // RHS evaluations and Runge-Kutta steps are added to *counters, nullptr disables counting
+    inline void set_counters(PhaseCounters* counters) {
+        _counters = counters;
+    }
 
     void operator ()(const Matrix&, Matrix&, double);
 
     virtual void make_step_forward(Matrix&, double&) const = 0;
 
+    // makes step, but not beyond tMax; returns true if tMax is reached
+    virtual bool make_step_forward(Matrix&, double&, double tMax) const = 0;
+
+    /* Integrates up to tMax with steps limited by the error control only and passes the state interpolated by the
+       dense output of the stepper to observer at every multiple of dtOut in (t, tMax]. Returns true if tMax is
+       reached, false if observer stopped the integration; C and t are left at the last moment. */
+    virtual bool sample(Matrix&, double&, double tMax, double dtOut, const Observer&) const = 0;
+
     inline double forsingPower(double t) const {
         return trace(FFdag(t));
     }
 
+    // steady covariance for coefficients frozen at t
+    inline Matrix steady_state(double t) const {
+        return solveLyapunov(A(t), FFdag(t));
+    }
+
     virtual ~AbstractLyapunovEquation() = default;
 };
 
@@ -80,7 +183,9 @@ class LyapunovEquationWithFlatForcing : public AbstractLyapunovEquation {
 
     void make_step_forward(Matrix&, double&) const override;
 
-    bool make_step_forward(Matrix&, double&, double) const;
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
 };
 
 class LyapunovEquationWith2DFlatForcing : public AbstractLyapunovEquation {
@@ -92,6 +197,10 @@ class LyapunovEquationWith2DFlatForcing : public AbstractLyapunovEquation {
         AbstractLyapunovEquation(data, k) {}
 
     void make_step_forward(Matrix&, double&) const override;
+
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
 };
 
 class LyapunovEquationWith2DWhiteForcing : public AbstractLyapunovEquation {
@@ -103,6 +212,10 @@ class LyapunovEquationWith2DWhiteForcing : public AbstractLyapunovEquation {
         AbstractLyapunovEquation(data, k) {}
 
     void make_step_forward(Matrix&, double&) const override;
+
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
 };
 
 class LyapunovEquationWith3DWhiteForcing : public AbstractLyapunovEquation {
@@ -114,6 +227,10 @@ class LyapunovEquationWith3DWhiteForcing : public AbstractLyapunovEquation {
         AbstractLyapunovEquation(data, k) {}
 
     void make_step_forward(Matrix&, double&) const override;
+
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
 };
 
 class LyapunovEquationWith2DVorticalWhiteForcing : public AbstractLyapunovEquation {
@@ -125,6 +242,10 @@ class LyapunovEquationWith2DVorticalWhiteForcing : public AbstractLyapunovEquati
         AbstractLyapunovEquation(data, k) {}
 
     void make_step_forward(Matrix&, double&) const override;
+
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
 };
 
 class LyapunovEquationWith2DSoundWhiteForcing : public AbstractLyapunovEquation {
@@ -136,6 +257,10 @@ class LyapunovEquationWith2DSoundWhiteForcing : public AbstractLyapunovEquation
         AbstractLyapunovEquation(data, k) {}
 
     void make_step_forward(Matrix&, double&) const override;
+
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
 };
 
 class LyapunovEquationWithoutForcing : public AbstractLyapunovEquation {
@@ -148,5 +273,144 @@ class LyapunovEquationWithoutForcing : public AbstractLyapunovEquation {
 
     void make_step_forward(Matrix&, double&) const override;
 
-    bool make_step_forward(Matrix&, double&, double) const;
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
+};
+
+/* Evolves the state-transition matrix Phi(t) of du/dt = A(t) u with Phi(0) = I. Its 4 columns are solutions started
+   from unit vectors, they are advanced as one 4 x 4 state and share the step control. */
+class StateTransitionEquation : public AbstractLyapunovEquation {
+ private:
+    Matrix FFdag(double) const override;
+
+ public:
+    explicit StateTransitionEquation(const Parameters& data, const WaveVector& k) :
+        AbstractLyapunovEquation(data, k) {}
+
+    void operator ()(const Matrix&, Matrix&, double);
+
+    void make_step_forward(Matrix&, double&) const override;
+
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
+};
+
+std::shared_ptr <AbstractLyapunovEquation> make_equation(Forcing forcing, const Parameters& data, const WaveVector& k);
+
+/* Evolves one covariance per forcing model along the same SFH. The state is 4 x 4N matrix of stacked covariances,
+   A(t) is evaluated once per RHS call and all models share the step control. */
+class LyapunovEquationWithMultipleForcing : public AbstractLyapunovEquation {
+ private:
+    std::vector <std::shared_ptr <AbstractLyapunovEquation>> _models;
+
+    Matrix FFdag(double) const override;
+
+ public:
+    LyapunovEquationWithMultipleForcing(const Parameters& data, const WaveVector& k, const std::vector <Forcing>& forcings);
+
+    void operator ()(const Matrix&, Matrix&, double);
+
+    void make_step_forward(Matrix&, double&) const override;
+
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
+
+    inline size_t size() const {
+        return _models.size();
+    }
+
+    inline double forsingPower(size_t n, double t) const {
+        return trace(_models[n]->FFdag(t));
+    }
+};
+
+/* Forward sensitivities of the Lyapunov equation of forcing. The state is 4 (1 + P) x 4 matrix of stacked C and its
+   derivatives S_n = dC/dp_n over P parameters, every 4 x 4 block is contiguous. The derivatives obey
+   dS/dt = A S + S A^T + dA/dp C + C dA/dp^T + dQ/dp, where dA/dp and dQ/dp are differentiated analytically from the
+   terms of A(t) and FFdag(t). All blocks share the step control. */
+class TangentLinearEquation : public AbstractLyapunovEquation {
+ private:
+    const Forcing _forcing;
+    const std::shared_ptr <AbstractLyapunovEquation> _model;
+    const std::vector <Sensitivity> _parameters;
+
+    Matrix FFdag(double t) const override;
+
+    // dA/dp and dQ/dp of parameter at t
+    void derivatives(Sensitivity parameter, double t, double dA[4][4], double dQ[4][4]) const;
+
+ public:
+    TangentLinearEquation(const Parameters& data, const WaveVector& k, Forcing forcing,
+                          const std::vector <Sensitivity>& parameters);
+
+    void operator ()(const Matrix&, Matrix&, double);
+
+    void make_step_forward(Matrix&, double&) const override;
+
+    bool make_step_forward(Matrix&, double&, double) const override;
+
+    bool sample(Matrix&, double&, double, double, const Observer&) const override;
+
+    inline size_t size() const {
+        return _parameters.size();
+    }
+
+    // zero C and its derivatives
+    inline Matrix initial_state() const {
+        return ZeroMatrix(4 * (_parameters.size() + 1), 4);
+    }
+
+    // F F^dag of the forcing at t
+    inline Matrix forcing(double t) const {
+        return FFdag(t);
+    }
+
+    // derivative of forcing power over the n-th parameter
+    double forsingPowerDerivative(size_t n, double t) const;
+
+    // trace and flux of the n-th block of the state, n = 0 is C itself and n > 0 is dC/dp_(n - 1)
+    static inline double trace(const Matrix& S, size_t n) {
+        return S(4 * n, 0) + S(4 * n + 1, 1) + S(4 * n + 2, 2) + S(4 * n + 3, 3);
+    }
+
+    static inline double get_flux(const Matrix& S, size_t n) {
+        return S(4 * n, 1);
+    }
+};
+
+/* Fourth order Magnus integrator of the Lyapunov equation of eq. The equation is lifted to the linear system for
+   10 independent entries of C, integrals of trace(C), get_flux(C) and forcing power over t and a unit entry carrying
+   the forcing. Its generator is evaluated at two Gauss points of the step and the step is made by the exponential
+   of the 14 x 14 Magnus matrix, so it is not limited by the acoustic period 1 / |k| and may span many of them.
+   The error is estimated by step doubling. Integrals are exact for the polynomial in time entries of A(t). */
+class MagnusPropagator {
+ private:
+    static constexpr int N = 14;
+
+    typedef std::array <double, N> State;
+    typedef std::array <double, N * N> Generator;
+
+    const AbstractLyapunovEquation& _eq;
+    const double _tolerance;
+    double _dt;
+
+    Generator generator(double t) const;
+
+    // a b by the kernel of the instruction set of _eq
+    Generator multiply(const Generator& a, const Generator& b) const;
+
+    State step(const State& y, double t, double dt) const;
+
+ public:
+    MagnusPropagator(const AbstractLyapunovEquation& eq, double t, double tolerance = 1e-6) :
+        _eq(eq),
+        _tolerance(tolerance),
+        _dt(eq.get_dt(t)) {}
+
+    /* Makes one accepted step, but not beyond tMax, and adds integrals over it of trace(C), get_flux(C) and forcing
+       power over t to E, I and EIn. Returns true if tMax is reached. */
+    bool make_step_forward(Matrix& C, double& t, double tMax, double& E, double& I, double& EIn);
 };
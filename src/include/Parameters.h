@@ -13,23 +13,101 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 #include <string>
 #include <cmath>
 #include <fstream>
+#include <ostream>
+#include <vector>
+
+namespace boost {
+namespace program_options {
+class options_description;
+}  // namespace program_options
+}  // namespace boost
+
+// integrator of a phase of the SFH: adaptive Runge-Kutta or exponential (Magnus) propagator
+enum class Stepper {
+    RungeKutta,
+    Magnus
+};
+
+std::string stepperName(Stepper stepper);
+
+// throws std::invalid_argument for unknown names
+Stepper stepperFromName(const std::string& name);
+
+// placement of OpenMP threads: left to the system, filling sockets one by one or alternating between sockets
+enum class Affinity {
+    None,
+    Compact,
+    Spread
+};
+
+std::string affinityName(Affinity affinity);
+
+// throws std::invalid_argument for unknown names
+Affinity affinityFromName(const std::string& name);
+
+// instruction set of the dispatched kernels, Auto picks the best one supported by the CPU
+enum class Isa {
+    Auto,
+    Generic,
+    Sse42,
+    Avx2,
+    Avx512
+};
+
+std::string isaName(Isa isa);
+
+// throws std::invalid_argument for unknown names
+Isa isaFromName(const std::string& name);
+
+// diagnostics of integrateOverX, see Reducers
+enum class Reduction {
+    Energy,
+    Components,
+    Dissipation,
+    Peak
+};
+
+std::string reductionName(Reduction reduction);
+
+// throws std::invalid_argument for unknown names
+Reduction reductionFromName(const std::string& name);
+
+// comma-separated names, throws std::invalid_argument for unknown names
+std::vector <Reduction> reductionsFromNames(const std::string& names);
 
 class Parameters {
  private:
-    static constexpr int NParams = 5;
+    static constexpr int NParams = 13;
+    static constexpr int NStrParams = 3;
 
     static constexpr const double PI = std::atan(1.0) * 4;
 
     typedef std::array <double, NParams> ParamsArray;
+    typedef std::array <std::string, NStrParams> StrParamsArray;
 
+    StrParamsArray _sA;
     ParamsArray _pA;
-    ParamsArray InitParams(int, char**);
+    ParamsArray InitParams(int, char**, const boost::program_options::options_description&);
+
+    Parameters(const ParamsArray&, const StrParamsArray&, const std::vector <Reduction>&);
 
     static constexpr int qPosition        = 0;
     static constexpr int invRePosition    = 1;
     static constexpr int invRe_bPosition  = 2;
     static constexpr int CtPosition       = 3;
     static constexpr int NtPosition       = 4;
+    static constexpr int progressPosition = 5;
+    static constexpr int richardsonPosition = 6;
+    static constexpr int forcedStepperPosition = 7;
+    static constexpr int freeStepperPosition   = 8;
+    static constexpr int affinityPosition      = 9;
+    static constexpr int isaPosition           = 10;
+    static constexpr int autotunePosition      = 11;
+    static constexpr int cubaturePosition      = 12;
+
+    static constexpr int countersPosition = 0;
+    static constexpr int statusPosition   = 1;
+    static constexpr int reducersPosition = 2;
 
  public:
     const double q;
@@ -38,10 +116,71 @@ class Parameters {
     const double Ct;
     const int Nt;
 
+    // interval between progress reports of the maps, s, 0 disables them and the refinement reports of the cubature
+    const double progress;
+
+    // number of Courant constants Ct, 2 Ct, 4 Ct, ... used by the maps for Richardson extrapolation, 1 disables it
+    const int richardson;
+
+    // integrators of the forced and free decay phases of integrateOverX
+    const Stepper forcedStepper;
+    const Stepper freeStepper;
+
+    // placement of the data.Nt threads on CPUs, see setThreads()
+    const Affinity affinity;
+
+    // instruction set of the kernels, see kernels()
+    const Isa isa;
+
+    // tolerance of the relative error of the configuration chosen by autotune(), 0 disables autotuning
+    const double autotune;
+
+    // relative tolerance of the adaptive cubature of Spectra(ky, kz) over (ky, kz), 0 uses the uniform grid
+    const double cubature;
+
+    // side-car file for the step and timing counters of the map cells, empty if instrumentation is off
+    const std::string counters;
+
+    // status file rewritten with every progress report, may be empty
+    const std::string status;
+
+    // comma-separated names of the diagnostic reducers of integrateOverX, see Reducers
+    const std::string reducers;
+
+    // reducers parsed once from the command line
+    const std::vector <Reduction> reductions;
+
+    // command line options which are neither listed here nor in driverOptions are rejected, so a mistyped option
+    // throws boost::program_options::unknown_option instead of leaving the default value
     Parameters(int, char**);
 
+    Parameters(int, char**, const boost::program_options::options_description& driverOptions);
+
+    // parameters without command line, other options take their default values
+    Parameters(double q, double invRe, double invRe_b, double Ct, int Nt);
+
+    Parameters withNt(int) const;
+
+    Parameters withCt(double) const;
+
+    // inverse Reynolds numbers, 0 for inviscid flow
+    Parameters withInvRe(double invRe, double invRe_b) const;
+
+    Parameters withSteppers(Stepper forced, Stepper free) const;
+
+    Parameters withRichardson(int levels) const;
+
+    // without progress reports, status and counters files, reducers are kept
+    Parameters withoutReports() const;
+
     std::string params2Str() const;
 
+    // Ct, Richardson levels and steppers of integrateOverX
+    std::string integrator2Str() const;
+
+    // writes the configuration chosen by autotune() as a comment line, nothing if autotuning is off
+    void outputTuning(std::ostream& os) const;
+
     void output() const;
 };
 
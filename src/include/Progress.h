@@ -0,0 +1,76 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <omp.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Affinity.h"
+#include "Parameters.h"
+
+/* Reports progress of a map computation from a separate thread every data.progress seconds: completed cells, cells per
+   second, ETA, cells done by every thread and every socket since the previous report and resident memory. The report
+   goes to stderr and, if data.status is not empty, the status file is rewritten. Compute threads only call add() once
+   per cell. */
+class Progress {
+ private:
+    // every thread has its own cache line for every socket, counters start at line boundaries
+    struct alignas(64) Counter {
+        std::atomic <uint64_t> n;
+        char padding[64 - sizeof(std::atomic <uint64_t>)];
+    };
+
+    const std::string _name;
+    const uint64_t _nCells;
+    const double _interval;
+    const std::string _status;
+    const int _nThreads;
+    const int _nSockets;
+    const double _start;
+
+    std::unique_ptr <Counter[], void (*)(void*)> _counters;  // by thread and socket of the CPU which completed the cell
+    std::vector <uint64_t> _lastCounts;
+    double _lastTime;
+
+    bool _stop;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::thread _thread;
+
+    // zeroed counters with the alignment of Counter, which new does not respect before C++17; freed by std::free
+    static Counter* newCounters(size_t n);
+
+    void run();
+
+    void report(bool final);
+
+ public:
+    Progress(const Parameters& data, const std::string& name, uint64_t nCells);
+
+    Progress(const Progress&) = delete;
+
+    Progress& operator = (const Progress&) = delete;
+
+    ~Progress();
+
+    inline void add() {
+        const int thread = omp_get_thread_num() % _nThreads;
+        _counters[thread * _nSockets + currentSocket() % _nSockets].n.fetch_add(1, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,71 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "LyapunovEquations.h"
+#include "Parameters.h"
+#include "WaveVector.h"
+
+/* Diagnostics reduced in stream from the covariance trajectory of integrateOverX. Reducers are called on each
+   accepted step of both phases and their values form the variable-width record IntegratorOut::reduced, so an analysis
+   needs a single pass and no trajectory output. Integrals over kx are evaluated by the trapezoid rule on the steps. */
+class Reducer {
+ public:
+    virtual ~Reducer() = default;
+
+    // accepted step from t0 to t of the SFH with the wave vector k at t = 0
+    virtual void step(const WaveVector& k, double t0, const Matrix& C0, double t, const Matrix& C) = 0;
+
+    // names of the values appended by append()
+    virtual std::vector <std::string> names() const = 0;
+
+    virtual void append(std::vector <double>& record) const = 0;
+
+    // values are kx-integrals, which are extrapolated in Ct like Ex; others are taken from the finest run
+    virtual bool integral() const {
+        return true;
+    }
+};
+
+/* Per-cell accumulators of the reducers parsed into data.reductions from the comma-separated names in data.reducers:
+     energy      -- kx-integrals of the kinetic and acoustic energy: Kx, Ax;
+     components  -- kx-integrals of the diagonal of C: Cxx, Cyy, Czz, Cww;
+     dissipation -- kx-integral of the viscous dissipation rate of the kinetic energy: Dx;
+     peak        -- maximum of trace(C) and kx where it is reached: Emax, kxEmax.
+   Parameters rejects the names together with the Magnus stepper in either phase, whose steps span many acoustic
+   periods and cannot be sampled by trapezoids. */
+class Reducers {
+ private:
+    std::vector <std::unique_ptr <Reducer>> _reducers;
+
+ public:
+    explicit Reducers(const Parameters& data);
+
+    inline bool empty() const {
+        return _reducers.empty();
+    }
+
+    void step(const WaveVector& k, double t0, const Matrix& C0, double t, const Matrix& C);
+
+    std::vector <std::string> names() const;
+
+    std::vector <double> record() const;
+
+    // Reducer::integral() of every value of record()
+    std::vector <bool> integrals() const;
+};
+
+// comment line with the names of the reduced columns at the end of the rows, nothing if data.reducers is empty
+void outputReducedColumns(const Parameters& data, std::ostream& os);
@@ -0,0 +1,94 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "integrator.h"
+#include "LyapunovEquations.h"
+#include "Parameters.h"
+
+/* Query server on Unix domain socket. Requests are text lines, every reply starts with "ok" or "error":
+
+     cell R R_b forcing kxMin kxMax ky kz                  -> ok Ex Ix EInx
+     map R R_b forcing kxMin dkx nx kyMin dky ny kz        -> ok n, then n lines kx ky Ex Ix EInx
+     stats                                                 -> ok requests cells hits coalesced computed cached
+     quit                                                  closes connection
+     shutdown                                              stops the server
+
+   R and R_b may be inf, forcing None is rejected. q and Ct are those of the server. Cells are integrated by a pool of
+   data.Nt threads, results are kept in a cache of at most cacheSize cells, maps of more cells are rejected. Identical
+   cells requested while being integrated are computed once. */
+class Server {
+ private:
+    // (1 / R, 1 / R_b, forcing, kxMin, kxMax, ky, kz)
+    typedef std::tuple <double, double, int, double, double, double, double> Key;
+
+    struct Entry {
+     public:
+        bool done;
+        std::string error;
+        IntegratorOut iOut;
+    };
+
+    const Parameters _data;
+    const std::string _socketName;
+    const size_t _cacheSize;
+
+    std::mutex _mutex;
+    std::condition_variable _taskReady;
+    std::condition_variable _resultReady;
+    std::map <Key, std::shared_ptr <Entry>> _cache;
+    std::deque <Key> _tasks;
+    std::deque <Key> _order;  // completed cells from the oldest one, for eviction
+    bool _stopping;
+    int _listener;
+
+    struct Statistics {
+     public:
+        size_t requests;
+        size_t cells;
+        size_t hits;
+        size_t coalesced;
+        size_t computed;
+    } _statistics;
+
+    std::vector <std::thread> _workers;
+
+    void worker();
+
+    // cells are queued all at once and are waited for together; throws std::runtime_error if any cell failed
+    std::vector <IntegratorOut> evaluate(const std::vector <Key>& keys);
+
+    void serve(int fd);
+
+    // reply to the request line, sets close if the connection has to be closed
+    std::string handle(const std::string& line, bool& close);
+
+ public:
+    Server(const Parameters& data, const std::string& socketName, size_t cacheSize);
+
+    Server(const Server&) = delete;
+
+    Server& operator = (const Server&) = delete;
+
+    // blocks until shutdown request
+    void run();
+
+    ~Server();
+};
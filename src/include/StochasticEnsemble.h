@@ -0,0 +1,58 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Affinity.h"
+#include "integrator.h"
+#include "LyapunovEquations.h"
+#include "Parameters.h"
+#include "WaveVector.h"
+
+/* Monte Carlo counterpart of integrateOverX. Ensemble of realizations of linear SDE du = A(t) u dt + F(t) dW with
+   F F^T = FFdag(t) is advanced as u(t + dt) = Phi u(t) + G xi, where Phi is the transition matrix of the step, G G^T
+   is the noise covariance accumulated during the step and xi are standard normal numbers. Ensemble is stored as
+   structure of arrays and is split between data.Nt threads, which are pinned by the constructor and first touch their
+   blocks. Normal numbers come from counter-based Philox4x32-10 generator with counter (member, step), so the result
+   does not depend on the number of threads. */
+class StochasticEnsemble {
+ private:
+    static constexpr size_t blockSize = 256;
+
+    const Parameters _data;
+    const WaveVector _k;
+    const std::shared_ptr <AbstractLyapunovEquation> _eq;
+    const size_t _nMembers;
+    const uint64_t _seed;
+
+    std::array <FirstTouchVector <double>, 4> _u;
+    FirstTouchVector <double> _Ex;
+    FirstTouchVector <double> _Ix;
+    uint64_t _nStep;
+
+    Matrix propagator(double t, double dt) const;
+
+    // advances members from t to t + dt and adds trapezoid dkx-integrals, returns ensemble average of trace(C)
+    double make_step_forward(double t, double dt, bool forced, double dkx);
+
+    // adds end-point corrections u^2 * 0.5 * dkx, returns ensemble average of trace(C)
+    double add_end_point(double dkx);
+
+ public:
+    StochasticEnsemble(const Parameters& data, const WaveVector& k, Forcing forcing, size_t nMembers, uint64_t seed);
+
+    // the same quadrature and stopping criterion as integrateOverX(data, k.x(), kxMax, k.y(), k.z(), forcing);
+    // standard errors of the sample means are written to error
+    IntegratorOut integrateOverX(double kxMax, IntegratorOut& error);
+};
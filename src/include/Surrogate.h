@@ -0,0 +1,92 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "integrator.h"
+#include "Parameters.h"
+
+// box [kxMin, kxMax] x [kyMin, kyMax] x [kzMin, kzMax] split into patches, degenerate axes get a single node
+struct SurrogateBox {
+ public:
+    std::array <double, 3> kMin;
+    std::array <double, 3> kMax;
+    std::array <int, 3> patches;
+    int degree;   // of the Chebyshev polynomials along every axis of a patch
+};
+
+/* Surrogate of the cells [kx, kx + dk] x ky x kz of flat forcing at fixed R and R_b. Ex, Ix and EInx are piecewise
+   tensor Chebyshev interpolants on the patches of the box. Every patch has the error estimate from the held-out
+   cells: the maximal error of Ex, Ix and EInx relative to the maximum of their absolute values on the patch. Models
+   are stored in the binary file of header, errors and coefficients. */
+class Surrogate {
+ private:
+    static constexpr int nChannels = 3;
+
+    double _q;
+    double _invRe;
+    double _invRe_b;
+    double _Ct;
+    int _richardson;
+    Stepper _forcedStepper;
+    Stepper _freeStepper;
+    double _dk;
+    SurrogateBox _box;
+    std::array <int, 3> _nodes;
+    std::vector <double> _errors;         // by patch
+    std::vector <double> _coefficients;   // by patch, channel and the coefficients of x, y, z with z fastest
+
+    Surrogate() :
+        _q(0), _invRe(0), _invRe_b(0), _Ct(0), _richardson(1), _forcedStepper(Stepper::RungeKutta),
+        _freeStepper(Stepper::RungeKutta), _dk(0), _box(), _nodes(), _errors(), _coefficients() {}
+
+    size_t nPatches() const;
+
+    size_t patchSize() const;
+
+    // patch containing k and local coordinates in [-1, 1]
+    size_t locate(const std::array <double, 3>& k, std::array <double, 3>& x) const;
+
+ public:
+    /* Integrates the Chebyshev nodes of every patch and nHeldOut random cells of it with data over data.Nt threads.
+       Throws std::invalid_argument for empty boxes or degree < 0. */
+    Surrogate(const Parameters& data, const SurrogateBox& box, double dk, int nHeldOut);
+
+    // throws std::runtime_error if the file is not a surrogate model of this format or its header is invalid
+    static Surrogate load(const std::string& name);
+
+    void save(const std::string& name) const;
+
+    bool contains(double kx, double ky, double kz) const;
+
+    // model value inside the box, error gets the error estimate of the patch
+    IntegratorOut evaluate(double kx, double ky, double kz, double& error) const;
+
+    // model value, or integrateOverX outside the box and on patches with error estimates above tolerance
+    IntegratorOut query(double kx, double ky, double kz, double tolerance, bool& integrated) const;
+
+    // q, R, R_b, Ct, Richardson levels and steppers of the model
+    Parameters parameters() const;
+
+    inline double dk() const {
+        return _dk;
+    }
+
+    inline const SurrogateBox& box() const {
+        return _box;
+    }
+
+    inline const std::vector <double>& errors() const {
+        return _errors;
+    }
+};
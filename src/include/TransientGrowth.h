@@ -0,0 +1,35 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <vector>
+
+#include "Parameters.h"
+#include "WaveVector.h"
+
+/* Optimal transient growth of SFH without forcing. Energy growth G(t) = max |u(t)|^2 / |u(0)|^2 over all initial
+   perturbations u(0) is the largest eigenvalue of Phi^T Phi, where Phi(t) is the state-transition matrix. The
+   optimal perturbation is the corresponding eigenvector. */
+
+struct Growth {
+    double t;
+    double G;
+    std::array <double, 4> u0;  // optimal initial perturbation, |u0| = 1
+};
+
+// G(t) at ascending output times, SFH starts from k at t = 0
+std::vector <Growth> transientGrowth(const Parameters& data, const WaveVector& k, const std::vector <double>& times);
+
+/* Optimal-growth map. Every SFH starts from kxMin, G is evaluated at nOut moments when kx(t) is uniformly distributed
+   over (kxMin, kxMax]. Rows contain ky, kz, maximal G, kx(t) at which it is reached and the optimal perturbation. */
+void growthMapKyKz(const Parameters& data, std::ostream& fOut, double dk, double kyMin, double kyMax,
+                   double kzMin, double kzMax, double kxMin, double kxMax, int nOut);
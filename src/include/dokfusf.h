@@ -0,0 +1,100 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+/* C interface of DOKFUSF library. Functions keep no global state and may be called from several threads at once,
+   results are written to the buffers of the caller, nothing is written to files. Every function returns
+   DOKFUSF_OK or negative error code. DOKFUSF_NONE is only a name: functions that integrate cells return
+   DOKFUSF_INVALID_ARGUMENT for it. */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DOKFUSF_ABI_VERSION 1
+
+#define DOKFUSF_OK                 0
+#define DOKFUSF_INVALID_ARGUMENT  -1
+#define DOKFUSF_NUMERICAL_ERROR   -2
+#define DOKFUSF_INTERNAL_ERROR    -3
+
+typedef enum {
+    DOKFUSF_FLAT              = 0,
+    DOKFUSF_FLAT_2D           = 1,
+    DOKFUSF_WHITE_2D          = 2,
+    DOKFUSF_WHITE_3D          = 3,
+    DOKFUSF_VORTICAL_WHITE_2D = 4,
+    DOKFUSF_SOUND_WHITE_2D    = 5,
+    DOKFUSF_NONE              = 6
+} dokfusf_forcing;
+
+typedef struct {
+    double q;           // shear rate
+    double invRe;       // 1 / R, 0 for inviscid flow
+    double invRe_b;     // 1 / R_b
+    double Ct;          // Courant constant
+    int Nt;             // number of threads of batched calls
+    int richardson;     // number of Ct levels of Richardson extrapolation, 1 disables it
+} dokfusf_parameters;
+
+typedef struct {
+    double Ex;
+    double Ix;
+    double EInx;
+} dokfusf_result;
+
+int dokfusf_abi_version(void);
+
+// parameters of the command-line drivers by default
+void dokfusf_default_parameters(dokfusf_parameters* data);
+
+// name of the forcing as used by the drivers, NULL for unknown forcing
+const char* dokfusf_forcing_name(dokfusf_forcing forcing);
+
+int dokfusf_forcing_from_name(const char* name, dokfusf_forcing* forcing);
+
+// single cell, error gets Richardson error estimate and may be NULL
+int dokfusf_integrate_over_x(const dokfusf_parameters* data, double kxMin, double kxMax, double ky, double kz,
+                             dokfusf_forcing forcing, dokfusf_result* result, dokfusf_result* error);
+
+// n independent cells evaluated in parallel over data->Nt threads, errors may be NULL
+int dokfusf_integrate_cells(const dokfusf_parameters* data, size_t n, const double* kxMin, const double* kxMax,
+                            const double* ky, const double* kz, dokfusf_forcing forcing,
+                            dokfusf_result* results, dokfusf_result* errors);
+
+/* Single cell and gradients of Ex, Ix and EInx over kx, ky, kz and R in this order from one run of forward
+   sensitivities, see TangentLinearEquation. kx moves the whole cell, the gradient over R is 0 for inviscid flow.
+   The Runge-Kutta stepper is used and data->richardson is ignored. */
+int dokfusf_integrate_gradient(const dokfusf_parameters* data, double kxMin, double kxMax, double ky, double kz,
+                               dokfusf_forcing forcing, dokfusf_result* result, dokfusf_result gradient[4]);
+
+/* Grid nx x ny of cells [kx, kx + dkx] x ky with kx = kxMin + i dkx, ky = kyMin + j dky at fixed kz, the same as
+   SolutionMap(kx, ky). Results are stored row by row: results[j * nx + i]. */
+int dokfusf_map_kx_ky(const dokfusf_parameters* data, size_t nx, double kxMin, double dkx, size_t ny, double kyMin,
+                      double dky, double kz, dokfusf_forcing forcing, dokfusf_result* results, dokfusf_result* errors);
+
+// surrogate model written by the Surrogate driver, see Surrogate.h
+typedef struct dokfusf_surrogate dokfusf_surrogate;
+
+int dokfusf_surrogate_load(const char* name, dokfusf_surrogate** surrogate);
+
+void dokfusf_surrogate_free(dokfusf_surrogate* surrogate);
+
+/* Cell [kx, kx + dk] x ky x kz with dk of the model. The cell is integrated if it is outside the box of the model or
+   the error estimate of its patch exceeds tolerance. error gets the error estimate and may be NULL, integrated gets 1
+   if the cell was integrated and may be NULL. */
+int dokfusf_surrogate_evaluate(const dokfusf_surrogate* surrogate, double kx, double ky, double kz, double tolerance,
+                               dokfusf_result* result, double* error, int* integrated);
+
+#ifdef __cplusplus
+}
+#endif
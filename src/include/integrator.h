@@ -9,8 +9,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
 #pragma once
 
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <vector>
 
+#include "Instrumentation.h"
+#include "LyapunovEquations.h"
 #include "Parameters.h"
 #include "WaveVector.h"
 
@@ -20,12 +25,19 @@ struct IntegratorOut {
     double Ix;
     double EInx;
 
-    constexpr IntegratorOut() : Ex(0), Ix(0), EInx(0) {}
+    // values of the reducers of data.reducers in their order, empty without reducers
+    std::vector <double> reduced;
+
+    IntegratorOut() : Ex(0), Ix(0), EInx(0), reduced() {}
 
     IntegratorOut& operator += (const IntegratorOut& rhs) {
         Ex   += rhs.Ex;
         Ix   += rhs.Ix;
         EInx += rhs.EInx;
+        reduced.resize(std::max(reduced.size(), rhs.reduced.size()), 0);
+        for (size_t n = 0; n < rhs.reduced.size(); ++n) {
+            reduced[n] += rhs.reduced[n];
+        }
 
         return *this;
     }
@@ -34,6 +46,10 @@ struct IntegratorOut {
         Ex   -= rhs.Ex;
         Ix   -= rhs.Ix;
         EInx -= rhs.EInx;
+        reduced.resize(std::max(reduced.size(), rhs.reduced.size()), 0);
+        for (size_t n = 0; n < rhs.reduced.size(); ++n) {
+            reduced[n] -= rhs.reduced[n];
+        }
 
         return *this;
     }
@@ -42,10 +58,14 @@ struct IntegratorOut {
         Ex   *= d;
         Ix   *= d;
         EInx *= d;
+        for (double& value : reduced) {
+            value *= d;
+        }
 
         return *this;
     }
 
+    // Ex, Ix and EInx, see outputReduced() for the reduced values
     friend std::ostream& operator << (std::ostream& os, const IntegratorOut& iOut) {
         os << iOut.Ex << "\t" << iOut.Ix << "\t" << iOut.EInx;
         return os;
@@ -62,10 +82,61 @@ struct IntegratorOut {
     }
 };
 
-void integrationTest(const Parameters& data, const WaveVector& k, double tEnd);
+// reduced values of iOut as tab-separated columns following the others
+inline void outputReduced(std::ostream& os, const IntegratorOut& iOut) {
+    for (double value : iOut.reduced) {
+        os << "\t" << value;
+    }
+}
 
-IntegratorOut integrateOverX(const Parameters& data, double kxMax, double ky, double kz);
+// free evolution of a single SFH, the energy is written at every multiple of dtOut up to tEnd
+void integrationTest(const Parameters& data, const WaveVector& k, double tEnd, double dtOut = 0.01);
 
-IntegratorOut integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz);
+// steady covariance with the wave vector frozen at k
+Matrix frozenSteadyState(const Parameters& data, const WaveVector& k, Forcing forcing);
+
+// the same for every wave vector of the batch, in parallel
+std::vector <Matrix> frozenSteadyState(const Parameters& data, const std::vector <WaveVector>& ks, Forcing forcing);
+
+IntegratorOut integrateOverX(const Parameters& data, double kxMax, double ky, double kz);
 
-void integrate(const Parameters& data, const WaveVector& kMax, double dky, double dkz);
+/* If counters is not nullptr, work done for the cell is added to it. Reducers of data.reducers are called on every
+   accepted step and their record is returned in reduced. */
+IntegratorOut integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                             Forcing forcing, CellCounters* counters = nullptr);
+
+// flat forcing
+IntegratorOut integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                             CellCounters* counters = nullptr);
+
+/* The cell for several forcings from one stacked Runge-Kutta integration. Every forcing stops on its own condition, so
+   the results match single runs up to the tolerance of the shared adaptive substeps; reducers are not evaluated. */
+std::vector <IntegratorOut> integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                                           const std::vector <Forcing>& forcings);
+
+/* The cell and gradients of its Ex, Ix and EInx over parameters in the same order, from a single run of
+   TangentLinearEquation with the Runge-Kutta stepper. The derivative over kx moves the whole cell, the derivative over
+   ky includes the change of the forcing time (kxMax - kxMin) / (q ky). Derivatives include the motion of the end of the
+   free evolution, which is set by kx(t) = |kxMin| or by trace(C) = 0.1 EInx; reducers are not evaluated. */
+IntegratorOut integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz, Forcing forcing,
+                             const std::vector <Sensitivity>& parameters, std::vector <IntegratorOut>& gradient,
+                             CellCounters* counters = nullptr);
+
+/* Richardson extrapolation of integrateOverX to Ct -> 0 from runs with Courant constants 2^(levels - 1) Ct, ..., 2 Ct,
+   Ct assuming error expansion in powers Ct, Ct^2, ... The error estimate is the difference between the extrapolations
+   of the highest and the next lower order. levels = 1 is a single run with zero error estimate. */
+IntegratorOut extrapolateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                               Forcing forcing, int levels, IntegratorOut& error, CellCounters* counters = nullptr);
+
+// cell [kxMin, kxMax] x ky x kz of flat forcing used by the maps and Spectra(ky, kz), error gets the error estimate
+typedef std::function <IntegratorOut(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                                     IntegratorOut& error, CellCounters* counters)> CellEvaluator;
+
+// extrapolateOverX with data.richardson levels
+IntegratorOut evaluateCell(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                           IntegratorOut& error, CellCounters* counters);
+
+/* Spectra(ky, kz) and their integrals over the grid with steps dky, dkz, or by adaptive cubature over the same
+   rectangle if data.cubature > 0. If output is false no files are written. */
+void integrate(const Parameters& data, const WaveVector& kMax, double dky, double dkz,
+               const CellEvaluator& evaluate = evaluateCell, bool output = true);
@@ -0,0 +1,37 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <ostream>
+
+#include "integrator.h"
+#include "Parameters.h"
+
+/* Solution maps of SolutionMap[..] and SolutionRelativeMap[..] drivers. Every cell is integrateOverX over [kx, kx + dk]
+   computed by evaluate, rows of the map are separated by blank lines. If data.richardson > 1 cells are extrapolated to
+   Ct -> 0 and error estimates of Ex, Ix and EInx are appended to the rows. */
+
+void mapKxKy(const Parameters& data, std::ostream& fOut, double dk,
+             double kxMin, double kxMax, double kyMin, double kyMax, double kz,
+             const CellEvaluator& evaluate = evaluateCell);
+
+void mapKxKz(const Parameters& data, std::ostream& fOut, double dk,
+             double kxMin, double kxMax, double kzMin, double kzMax, double ky,
+             const CellEvaluator& evaluate = evaluateCell);
+
+// kx = -(q * ky * R)^(1/3) is the optimal forcing wavenumber
+void mapKyKz(const Parameters& data, std::ostream& fOut, double dk,
+             double kyMin, double kyMax, double kzMin, double kzMax,
+             const CellEvaluator& evaluate = evaluateCell);
+
+// the same as mapKyKz, but values are also given relative to the kz = kzMin row
+void relativeMapKyKz(const Parameters& data, std::ostream& fOut, double dk,
+                     double kyMin, double kyMax, double kzMin, double kzMax,
+                     const CellEvaluator& evaluate = evaluateCell);
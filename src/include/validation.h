@@ -0,0 +1,68 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "integrator.h"
+#include "LyapunovEquations.h"
+#include "Parameters.h"
+
+// Cell of the golden-reference set
+struct ValidationCase {
+ public:
+    double kxMin;
+    double kxMax;
+    double ky;
+    double kz;
+    double invRe;
+    double invRe_b;
+    Forcing forcing;
+    IntegratorOut reference;
+
+    // data with the Reynolds numbers of the case
+    Parameters parameters(const Parameters& data) const {
+        return data.withInvRe(invRe, invRe_b);
+    }
+};
+
+// Integration mode checked against the reference
+struct Mode {
+ public:
+    std::string name;
+    std::function <IntegratorOut(const Parameters&, const ValidationCase&)> integrate;
+};
+
+struct ModeReport {
+ public:
+    std::string name;
+    double maxError;   // maximal relative error of Ex, Ix and EInx over the cases
+    double meanError;
+    double time;       // total wall time, s
+    bool pareto;       // no other mode is both faster and more accurate
+};
+
+std::vector <ValidationCase> readReference(const std::string& name);
+
+void writeReference(const std::string& name, const std::vector <ValidationCase>& cases, double Ct);
+
+/* Reference values of the cases computed with Courant constant Ct by the Runge-Kutta stepper without extrapolation,
+   whatever the integrator of data, in parallel over data.Nt threads. */
+void computeReference(const Parameters& data, std::vector <ValidationCase>& cases, double Ct);
+
+/* Largest relative error of Ex, Ix and EInx. The momentum flux may change sign and vanish, so its error is relative
+   to at least 1e-3 |Ex| of the reference. */
+double relativeError(const IntegratorOut& iOut, const IntegratorOut& reference);
+
+// modes are run one by one on a single thread so that the times are comparable
+std::vector <ModeReport> validate(const Parameters& data, const std::vector <ValidationCase>& cases,
+                                  const std::vector <Mode>& modes);
@@ -7,16 +7,234 @@ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FO
 License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
 Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
+#include <omp.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
 #include "include/Parameters.h"
 #include "include/WaveVector.h"
+#include "include/LyapunovEquations.h"
 #include "include/integrator.h"
+#include "include/validation.h"
+
+namespace po = boost::program_options;
+
+// golden-reference set: {kxMin, kxMax, ky, kz, 1 / R, 1 / R_b, forcing}
+std::vector <ValidationCase> referenceCases() {
+    return {
+        {-5.1,  -5.0,  1.0, 0.5, 1.0 / 7e3, 0,         Forcing::Flat,            IntegratorOut()},
+        {-21.9, -21.8, 1.0, 0.0, 1.0 / 7e3, 0,         Forcing::Flat,            IntegratorOut()},
+        {-2.0,  -1.9,  0.5, 1.0, 1.0 / 1e3, 1.0 / 1e3, Forcing::Flat,            IntegratorOut()},
+        {-5.1,  -5.0,  1.0, 0.0, 1.0 / 7e3, 0,         Forcing::VorticalWhite2D, IntegratorOut()},
+        {-5.1,  -5.0,  1.0, 0.0, 1.0 / 7e3, 0,         Forcing::SoundWhite2D,    IntegratorOut()},
+        {-3.0,  -2.9,  0.5, 0.5, 1.0 / 1e4, 0,         Forcing::White3D,         IntegratorOut()},
+        {-1.0,  -0.9,  2.0, 0.0, 1.0 / 3e3, 0,         Forcing::Flat2D,          IntegratorOut()},
+        {-4.0,  -3.9,  1.0, 1.0, 1.0 / 3e3, 1.0 / 3e2, Forcing::White2D,         IntegratorOut()}};
+}
+
+// candidate integration modes, the first one is the production mode
+std::vector <Mode> candidateModes(const Parameters& data) {
+    std::vector <Mode> modes;
+    modes.push_back({(boost::format("default Ct=%.3lg") % data.Ct).str(),
+        [](const Parameters& d, const ValidationCase& c) {
+            return integrateOverX(d, c.kxMin, c.kxMax, c.ky, c.kz, c.forcing); }});
 
+    for (double Ct : {0.05, 0.2, 0.5, 1.0}) {
+        modes.push_back({(boost::format("Ct=%.3lg") % Ct).str(),
+            [Ct](const Parameters& d, const ValidationCase& c) {
+                return integrateOverX(d.withCt(Ct), c.kxMin, c.kxMax, c.ky, c.kz, c.forcing); }});
+    }
+
+    for (int levels : {2, 3}) {
+        for (double Ct : {0.1, 0.2}) {
+            modes.push_back({(boost::format("Richardson %d levels Ct=%.3lg") % levels % Ct).str(),
+                [levels, Ct](const Parameters& d, const ValidationCase& c) {
+                    IntegratorOut error;
+                    return extrapolateOverX(d.withCt(Ct), c.kxMin, c.kxMax, c.ky, c.kz, c.forcing, levels, error); }});
+        }
+    }
+
+    for (Stepper forced : {Stepper::RungeKutta, Stepper::Magnus}) {
+        for (Stepper free : {Stepper::RungeKutta, Stepper::Magnus}) {
+            if ((forced == Stepper::RungeKutta) && (free == Stepper::RungeKutta)) {
+                continue;
+            }
+            modes.push_back({(boost::format("forced %s free %s") % stepperName(forced) % stepperName(free)).str(),
+                [forced, free](const Parameters& d, const ValidationCase& c) {
+                    return integrateOverX(d.withSteppers(forced, free), c.kxMin, c.kxMax, c.ky, c.kz, c.forcing); }});
+        }
+    }
+    return modes;
+}
+
+/* Gradients of Ex, Ix and EInx of the cells over kx, ky, kz and R from TangentLinearEquation against central
+   differences with relative step h; returns the largest relative deviation. */
+double checkSensitivities(const Parameters& data, const std::vector <ValidationCase>& cases, double h) {
+    const std::vector <Sensitivity> parameters = {Sensitivity::Kx, Sensitivity::Ky, Sensitivity::Kz, Sensitivity::R};
+    const Parameters rk = data.withSteppers(Stepper::RungeKutta, Stepper::RungeKutta);
+
+    fprintf(stdout, "%-16s %-3s %-4s %14s %14s %14s %10s\n", "forcing", "p", "X", "dX/dp", "difference", "deviation",
+            "speedup");
+    double maxDeviation = 0;
+    for (const ValidationCase& c : cases) {
+        const Parameters d = rk.withInvRe(c.invRe, c.invRe_b);
+        std::vector <IntegratorOut> gradient;
+        double time = -omp_get_wtime();
+        const IntegratorOut iOut = integrateOverX(d, c.kxMin, c.kxMax, c.ky, c.kz, c.forcing, parameters, gradient);
+        time += omp_get_wtime();
+
+        double timeDifferences = -omp_get_wtime();
+        for (size_t n = 0; n < parameters.size(); ++n) {
+            IntegratorOut plus;
+            IntegratorOut minus;
+            double step = h;
+            switch (parameters[n]) {
+                case Sensitivity::Kx:
+                    // shifts of the cell move the grid of the Courant steps, so the step is of order of the cell width
+                    step *= 10 * (c.kxMax - c.kxMin);
+                    plus  = integrateOverX(d, c.kxMin + step, c.kxMax + step, c.ky, c.kz, c.forcing);
+                    minus = integrateOverX(d, c.kxMin - step, c.kxMax - step, c.ky, c.kz, c.forcing);
+                    break;
+                case Sensitivity::Ky:
+                    step *= c.ky;
+                    plus  = integrateOverX(d, c.kxMin, c.kxMax, c.ky + step, c.kz, c.forcing);
+                    minus = integrateOverX(d, c.kxMin, c.kxMax, c.ky - step, c.kz, c.forcing);
+                    break;
+                case Sensitivity::Kz:
+                    step *= std::max(c.kz, 1.0);
+                    plus  = integrateOverX(d, c.kxMin, c.kxMax, c.ky, c.kz + step, c.forcing);
+                    minus = integrateOverX(d, c.kxMin, c.kxMax, c.ky, c.kz - step, c.forcing);
+                    break;
+                case Sensitivity::R:
+                    if (!(c.invRe > 0)) {
+                        continue;
+                    }
+                    step /= c.invRe;
+                    plus  = integrateOverX(d.withInvRe(1 / (1 / c.invRe + step), c.invRe_b),
+                                           c.kxMin, c.kxMax, c.ky, c.kz, c.forcing);
+                    minus = integrateOverX(d.withInvRe(1 / (1 / c.invRe - step), c.invRe_b),
+                                           c.kxMin, c.kxMax, c.ky, c.kz, c.forcing);
+                    break;
+            }
+            // the floor is 1e-3 of the value over the scale step / h of the parameter, so it has units of dX/dp
+            const double scale = step / h;
+            auto check = [&](const char* name, double derivative, double value, double valuePlus, double valueMinus) {
+                const double difference = (valuePlus - valueMinus) / (2 * step);
+                const double deviation  = std::abs(derivative - difference) /
+                                          (std::abs(difference) + std::abs(value) / scale * 1e-3);
+                maxDeviation = std::max(maxDeviation, deviation);
+                fprintf(stdout, "%-16s %-3s %-4s %14.6le %14.6le %14.3le\n", forcingName(c.forcing).c_str(),
+                        sensitivityName(parameters[n]).c_str(), name, derivative, difference, deviation);
+            };
+            check("Ex",   gradient[n].Ex,   iOut.Ex,   plus.Ex,   minus.Ex);
+            check("Ix",   gradient[n].Ix,   iOut.Ix,   plus.Ix,   minus.Ix);
+            check("EInx", gradient[n].EInx, iOut.EInx, plus.EInx, minus.EInx);
+        }
+        timeDifferences += omp_get_wtime();
+        fprintf(stdout, "%-16s %-3s %-4s %14s %14s %14s %10.2lf\n", forcingName(c.forcing).c_str(), "", "", "", "", "",
+                timeDifferences / time);
+    }
+    return maxDeviation;
+}
+
+/* Cells of the reference cases for all forcings at once from the stacked integrateOverX against single runs; returns
+   the largest relative error. */
+double checkForcings(const Parameters& data, const std::vector <ValidationCase>& cases) {
+    const std::vector <Forcing> forcings = {Forcing::Flat, Forcing::Flat2D, Forcing::White2D, Forcing::White3D,
+                                            Forcing::VorticalWhite2D, Forcing::SoundWhite2D};
+    const Parameters rk = data.withSteppers(Stepper::RungeKutta, Stepper::RungeKutta);
+
+    fprintf(stdout, "%-6s %-16s %14s %14s %12s\n", "case", "forcing", "Ex stacked", "Ex single", "error");
+    double maxError = 0;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const ValidationCase& c = cases[i];
+        const Parameters d = rk.withInvRe(c.invRe, c.invRe_b);
+        const std::vector <IntegratorOut> iOuts = integrateOverX(d, c.kxMin, c.kxMax, c.ky, c.kz, forcings);
+        for (size_t n = 0; n < forcings.size(); ++n) {
+            const IntegratorOut single = integrateOverX(d, c.kxMin, c.kxMax, c.ky, c.kz, forcings[n]);
+            const double error = relativeError(iOuts[n], single);
+            maxError = std::max(maxError, error);
+            fprintf(stdout, "%-6zu %-16s %14.6le %14.6le %12.3le\n", i, forcingName(forcings[n]).c_str(), iOuts[n].Ex,
+                    single.Ex, error);
+        }
+    }
+    return maxError;
+}
 
 int main(int ac, char **av) {
-    Parameters data(ac, av);
+    std::string mode;
+    std::string referenceName;
+    double referenceCt;
+    double tolerance;
+    double step;
+
+    po::options_description options("Validation options");
+    options.add_options()
+     ("mode",        po::value <std::string> (&mode)          -> default_value("validate"),
+        "validate: compare candidate modes with the reference, reference: compute the reference, "
+        "trajectory: single SFH evolution without forcing, "
+        "sensitivities: compare gradients of the reference cells with central differences, "
+        "forcings: compare the stacked integration of all forcings with single runs")
+     ("reference",   po::value <std::string> (&referenceName) -> default_value("./configs/reference.dat"),
+        "Reference file")
+     ("referenceCt", po::value <double> (&referenceCt)        -> default_value(1e-3), "Courant constant of the reference")
+     ("tolerance",   po::value <double> (&tolerance)          -> default_value(1e-2), "Allowed relative error")
+     ("step",        po::value <double> (&step)               -> default_value(1e-3),
+        "Relative step of central differences of the sensitivities mode");
+
+    Parameters data(ac, av, options);
     data.output();
 
-    integrationTest(data, WaveVector(data, -20, 1, 0), 30);
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
+
+    if (mode == "trajectory") {
+        integrationTest(data, WaveVector(data, -20, 1, 0), 30);
+        return 0;
+    }
+
+    if (mode == "sensitivities") {
+        const double deviation = checkSensitivities(data, referenceCases(), step);
+        fprintf(stdout, "max deviation %.3le\n", deviation);
+        return (deviation > tolerance) ? 1 : 0;
+    }
+
+    if (mode == "forcings") {
+        const double error = checkForcings(data, referenceCases());
+        fprintf(stdout, "max error %.3le\n", error);
+        return (error > tolerance) ? 1 : 0;
+    }
+
+    if (mode == "reference") {
+        std::vector <ValidationCase> cases = referenceCases();
+        computeReference(data, cases, referenceCt);
+        writeReference(referenceName, cases, referenceCt);
+        return 0;
+    }
+
+    const std::vector <ValidationCase> cases = readReference(referenceName);
+    if (cases.empty()) {
+        fprintf(stderr, "Reference %s is empty or not found\n", referenceName.c_str());
+        return 1;
+    }
+
+    const std::vector <ModeReport> reports = validate(data, cases, candidateModes(data));
+    fprintf(stdout, "%-24s %12s %12s %10s %s\n", "mode", "max error", "mean error", "time, s", "pareto");
+    for (const ModeReport& report : reports) {
+        fprintf(stdout, "%-24s %12.3le %12.3le %10.3lf %s\n", report.name.c_str(), report.maxError, report.meanError,
+                report.time, report.pareto ? "*" : "");
+    }
 
+    if (reports[0].maxError > tolerance) {
+        fprintf(stdout, "Error of the production mode exceeds tolerance %lg\n", tolerance);
+        return 1;
+    }
     return 0;
 }
@@ -11,22 +11,33 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
 #include <omp.h>
 
+#include <algorithm>
+#include <condition_variable>
 #include <fstream>
 #include <string>
+#include <utility>
 #include <vector>
 #include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cmath>
 
 #include <boost/format.hpp>
 
+#include "include/Affinity.h"
+#include "include/Cubature.h"
 #include "include/LyapunovEquations.h"
 #include "include/Parameters.h"
+#include "include/Progress.h"
+#include "include/Reducers.h"
 #include "include/WaveVector.h"
 
 inline uint32_t get_nk(const WaveVector& k, double dk) {
     return static_cast <uint32_t> ((abs(k) - std::numeric_limits <double>::epsilon()) / dk);
 }
 
-void integrationTest(const Parameters& data, const WaveVector& k, double tEnd) {
+void integrationTest(const Parameters& data, const WaveVector& k, double tEnd, double dtOut) {
     std::ofstream fEn;
     fEn.open(data.params2Str());
 
@@ -41,74 +52,484 @@ void integrationTest(const Parameters& data, const WaveVector& k, double tEnd) {
     C(1, 1) = uy * uy;
 
     double t  = 0;
-    while (t < tEnd) {
-        eq.make_step_forward(C, t);
-        fEn       << k.x(t) << "\t" << trace(C) << std::endl;
+    eq.sample(C, t, tEnd, dtOut, [&](double tOut, const Matrix& COut) {
+        fEn       << k.x(tOut) << "\t" << trace(COut) << std::endl;
+        return true;
+    });
+}
+
+Matrix frozenSteadyState(const Parameters& data, const WaveVector& k, Forcing forcing) {
+    return make_equation(forcing, data, k)->steady_state(0);
+}
+
+std::vector <Matrix> frozenSteadyState(const Parameters& data, const std::vector <WaveVector>& ks, Forcing forcing) {
+    const int N = static_cast <int> (ks.size());
+    std::vector <Matrix> C(N);
+    setThreads(data);
+    #pragma omp parallel for schedule(static)
+    for (int n = 0; n < N; ++n) {
+        C[n] = frozenSteadyState(data, ks[n], forcing);
     }
+    return C;
 }
 
-IntegratorOut integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz) {
+IntegratorOut integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                             Forcing forcing, CellCounters* counters) {
     IntegratorOut iOut;
+    Reducers reducers(data);
 
     Matrix C = ZeroMatrix(4, 4);
+    Matrix C0;
     double kx = kxMin;
     const WaveVector k(data, kx, ky, kz);
-    LyapunovEquationWithFlatForcing eqForcing(data, k);
-//    LyapunovEquationWith2DSoundWhiteForcing eqForcing(data, k);
-//    LyapunovEquationWith2DVorticalWhiteForcing eqForcing(data, k);
+    std::shared_ptr <AbstractLyapunovEquation> eqForcingPtr = make_equation(forcing, data, k);
+    AbstractLyapunovEquation& eqForcing = *eqForcingPtr;
+
+    if (counters != nullptr) {
+        eqForcing.set_counters(&counters->forced);
+        counters->forced.time -= omp_get_wtime();
+    }
+
+    double t = 0;
+    double dkx = 0;
+    const double tMax = (kxMax - k.x()) / ky / data.q;
+    bool finished = false;
+    if (data.forcedStepper == Stepper::Magnus) {
+        MagnusPropagator magnus(eqForcing, t);
+        double E   = 0;
+        double I   = 0;
+        double EIn = 0;
+        while (finished == false) {
+            const double t0 = t;
+            if (!reducers.empty()) {
+                C0 = C;
+            }
+
+            finished = magnus.make_step_forward(C, t, tMax, E, I, EIn);
+            if (!reducers.empty()) {
+                reducers.step(k, t0, C0, t, C);
+            }
+        }
+        iOut.Ex   += data.q * k.y() * E;
+        iOut.Ix   += data.q * k.y() * I;
+        iOut.EInx += EIn;
+    } else {
+        while (finished == false) {
+            double E0   = trace(C);
+            double I0   = get_flux(C);
+            double EIn0 = eqForcing.forsingPower(t);
+            double t0   = t;
+            if (!reducers.empty()) {
+                C0 = C;
+            }
+
+            finished = eqForcing.make_step_forward(C, t, tMax);
+            if (!reducers.empty()) {
+                reducers.step(k, t0, C0, t, C);
+            }
+
+            dkx = data.q * k.y() * (t - t0);
+            iOut.Ex   += (E0 + trace(C))    * 0.5 * dkx;
+            iOut.Ix   += (I0 + get_flux(C)) * 0.5 * dkx;
+            iOut.EInx += (EIn0 + eqForcing.forsingPower(t)) * 0.5 * (t - t0);
+        }
+        iOut.Ex += trace(C)    * 0.5 * dkx;
+        iOut.Ix += get_flux(C) * 0.5 * dkx;
+    }
+
+    LyapunovEquationWithoutForcing eq(data, k);
+    if (counters != nullptr) {
+        const double time = omp_get_wtime();
+        counters->forced.time += time;
+        counters->free.time   -= time;
+        eq.set_counters(&counters->free);
+    }
+    finished = false;
+    int nSteps = 0;
+    const int nStepsMin = 10;
+    if (data.freeStepper == Stepper::Magnus) {
+        MagnusPropagator magnus(eq, t);
+        while (finished == false) {
+            double E   = 0;
+            double I   = 0;
+            double EIn = 0;
+            const double t0 = t;
+            if (!reducers.empty()) {
+                C0 = C;
+            }
+
+            magnus.make_step_forward(C, t, std::numeric_limits <double>::infinity(), E, I, EIn);
+            if (!reducers.empty()) {
+                reducers.step(k, t0, C0, t, C);
+            }
+            iOut.Ex += data.q * k.y() * E;
+            iOut.Ix += data.q * k.y() * I;
+
+            finished = (k(t).x() > std::abs(kxMin)) && (nSteps > nStepsMin) && (trace(C) < 0.1 * iOut.EInx);
+            ++nSteps;
+        }
+    } else {
+        dkx = data.q * k.y() * eq.get_dt(t);
+        iOut.Ex += trace(C)    * 0.5 * dkx;
+        iOut.Ix += get_flux(C) * 0.5 * dkx;
+
+        while (finished == false) {
+            double E0 = trace(C);
+            double I0 = get_flux(C);
+            double t0 = t;
+            if (!reducers.empty()) {
+                C0 = C;
+            }
+
+            eq.make_step_forward(C, t);
+            if (!reducers.empty()) {
+                reducers.step(k, t0, C0, t, C);
+            }
+            dkx = data.q * k.y() * (t - t0);
+            iOut.Ex += (E0 + trace(C))    * 0.5 * dkx;
+            iOut.Ix += (I0 + get_flux(C)) * 0.5 * dkx;
+
+            finished = (k(t).x() > std::abs(kxMin)) && (nSteps > nStepsMin) && (trace(C) < 0.1 * iOut.EInx);
+            ++nSteps;
+        }
+        iOut.Ex += trace(C)    * 0.5 * dkx;
+        iOut.Ix += get_flux(C) * 0.5 * dkx;
+    }
+
+    if (counters != nullptr) {
+        counters->free.time += omp_get_wtime();
+    }
+
+    iOut.reduced = reducers.record();
+    return iOut;
+}
+
+IntegratorOut integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz, Forcing forcing,
+                             const std::vector <Sensitivity>& parameters, std::vector <IntegratorOut>& gradient,
+                             CellCounters* counters) {
+    const size_t N = parameters.size() + 1;
+
+    // iOuts[0] is the cell itself, iOuts[n] is its derivative over parameters[n - 1] at fixed factor q ky of Ex and Ix
+    std::vector <IntegratorOut> iOuts(N);
+    auto addHalf = [&](const Matrix& S, double dkx) {
+        for (size_t n = 0; n < N; ++n) {
+            iOuts[n].Ex += TangentLinearEquation::trace(S, n)    * 0.5 * dkx;
+            iOuts[n].Ix += TangentLinearEquation::get_flux(S, n) * 0.5 * dkx;
+        }
+    };
+
+    double kx = kxMin;
+    const WaveVector k(data, kx, ky, kz);
+    TangentLinearEquation eqForcing(data, k, forcing, parameters);
+    Matrix S = eqForcing.initial_state();
+    Matrix S0;
+
+    if (counters != nullptr) {
+        eqForcing.set_counters(&counters->forced);
+        counters->forced.time -= omp_get_wtime();
+    }
 
     double t = 0;
     double dkx = 0;
     const double tMax = (kxMax - k.x()) / ky / data.q;
     bool finished = false;
     while (finished == false) {
-        double E0   = trace(C);
-        double I0   = get_flux(C);
-        double EIn0 = eqForcing.forsingPower(t);
-        double t0   = t;
+        S0 = S;
+        double t0 = t;
 
-        finished = eqForcing.make_step_forward(C, t, tMax);
+        finished = eqForcing.make_step_forward(S, t, tMax);
 
         dkx = data.q * k.y() * (t - t0);
-        iOut.Ex   += (E0 + trace(C))    * 0.5 * dkx;
-        iOut.Ix   += (I0 + get_flux(C)) * 0.5 * dkx;
-        iOut.EInx += (EIn0 + eqForcing.forsingPower(t)) * 0.5 * (t - t0);
+        addHalf(S0, dkx);
+        addHalf(S, dkx);
+        iOuts[0].EInx += (eqForcing.forsingPower(t0) + eqForcing.forsingPower(t)) * 0.5 * (t - t0);
+        for (size_t n = 1; n < N; ++n) {
+            iOuts[n].EInx += (eqForcing.forsingPowerDerivative(n - 1, t0) +
+                              eqForcing.forsingPowerDerivative(n - 1, t)) * 0.5 * (t - t0);
+        }
+    }
+    addHalf(S, dkx);
+
+    /* tMax = (kxMax - kxMin) / (q ky) depends on ky. Moving the end of the forcing by dtMax adds Q(tMax) dtMax to C
+       of the free evolution and Q(tMax) dtMax to the integral of the forcing power. */
+    for (size_t n = 1; n < N; ++n) {
+        if (parameters[n - 1] == Sensitivity::Ky) {
+            const Matrix Q = eqForcing.forcing(tMax);
+            const double dtMax = -tMax / ky;
+            for (size_t i = 0; i < 4; ++i) {
+                for (size_t j = 0; j < 4; ++j) {
+                    S(4 * n + i, j) += Q(i, j) * dtMax;
+                }
+            }
+            iOuts[n].EInx += eqForcing.forsingPower(tMax) * dtMax;
+        }
     }
-    iOut.Ex += trace(C)    * 0.5 * dkx;
-    iOut.Ix += get_flux(C) * 0.5 * dkx;
 
-    LyapunovEquationWithoutForcing eq(data, k);
+    TangentLinearEquation eq(data, k, Forcing::None, parameters);
+    if (counters != nullptr) {
+        const double time = omp_get_wtime();
+        counters->forced.time += time;
+        counters->free.time   -= time;
+        eq.set_counters(&counters->free);
+    }
     dkx = data.q * k.y() * eq.get_dt(t);
-    iOut.Ex += trace(C)    * 0.5 * dkx;
-    iOut.Ix += get_flux(C) * 0.5 * dkx;
+    addHalf(S, dkx);
 
     finished = false;
     int nSteps = 0;
     const int nStepsMin = 10;
+    double t0 = t;
     while (finished == false) {
-        double E0 = trace(C);
-        double I0 = get_flux(C);
+        S0 = S;
+        t0 = t;
+
+        eq.make_step_forward(S, t);
+        dkx = data.q * k.y() * (t - t0);
+        addHalf(S0, dkx);
+        addHalf(S, dkx);
+
+        finished = (k(t).x() > std::abs(kxMin)) && (nSteps > nStepsMin) &&
+                   (TangentLinearEquation::trace(S, 0) < 0.1 * iOuts[0].EInx);
+        ++nSteps;
+    }
+    addHalf(S, dkx);
+
+    /* The end of the free evolution moves with the parameters as well: tEnd = (|kxMin| - kxMin) / (q ky) if it is set
+       by kx(t), trace(C(tEnd)) = 0.1 EInx gives dtEnd/dp = (0.1 dEInx/dp - trace(dC/dp)) / (dtrace(C)/dt) if it is
+       set by the trace and dtEnd = 0 if the loop is ended by the minimal number of steps. The condition which was
+       not met before the last step sets the end. The integrands at tEnd are added the same way as Q(tMax) above. */
+    const double rate = (TangentLinearEquation::trace(S, 0) - TangentLinearEquation::trace(S0, 0)) / (t - t0);
+    const bool endByKx    = (k(t0).x() <= std::abs(kxMin));
+    const bool endByTrace = !endByKx && !(TangentLinearEquation::trace(S0, 0) < 0.1 * iOuts[0].EInx);
+    for (size_t n = 1; n < N; ++n) {
+        double dtEnd = 0;
+        if (endByKx) {
+            if (parameters[n - 1] == Sensitivity::Kx) {
+                dtEnd = (kxMin < 0) ? -2 / (data.q * ky) : 0;
+            } else if (parameters[n - 1] == Sensitivity::Ky) {
+                dtEnd = -(std::abs(kxMin) - kxMin) / (data.q * ky * ky);
+            }
+        } else if (endByTrace && (rate < 0)) {
+            dtEnd = (0.1 * iOuts[n].EInx - TangentLinearEquation::trace(S, n)) / rate;
+        }
+        iOuts[n].Ex += TangentLinearEquation::trace(S, 0)    * data.q * ky * dtEnd;
+        iOuts[n].Ix += TangentLinearEquation::get_flux(S, 0) * data.q * ky * dtEnd;
+    }
+
+    if (counters != nullptr) {
+        counters->free.time += omp_get_wtime();
+    }
+
+    // Ex and Ix are proportional to q ky
+    gradient.assign(iOuts.begin() + 1, iOuts.end());
+    for (size_t n = 0; n < parameters.size(); ++n) {
+        if (parameters[n] == Sensitivity::Ky) {
+            gradient[n].Ex += iOuts[0].Ex / ky;
+            gradient[n].Ix += iOuts[0].Ix / ky;
+        }
+    }
+    return iOuts[0];
+}
+
+IntegratorOut integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                             CellCounters* counters) {
+    return integrateOverX(data, kxMin, kxMax, ky, kz, Forcing::Flat, counters);
+}
+
+std::vector <IntegratorOut> integrateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                                           const std::vector <Forcing>& forcings) {
+    const size_t N = forcings.size();
+    std::vector <IntegratorOut> iOuts(N);
+
+    Matrix C = ZeroMatrix(4, 4 * N);
+    double kx = kxMin;
+    const WaveVector k(data, kx, ky, kz);
+    LyapunovEquationWithMultipleForcing eqForcing(data, k, forcings);
+
+    double t = 0;
+    double dkx = 0;
+    const double tMax = (kxMax - k.x()) / ky / data.q;
+    bool finished = false;
+    while (finished == false) {
+        const Matrix C0 = C;
         double t0 = t;
 
-        eq.make_step_forward(C, t);
+        finished = eqForcing.make_step_forward(C, t, tMax);
+
         dkx = data.q * k.y() * (t - t0);
-        iOut.Ex += (E0 + trace(C))    * 0.5 * dkx;
-        iOut.Ix += (I0 + get_flux(C)) * 0.5 * dkx;
+        for (size_t n = 0; n < N; ++n) {
+            iOuts[n].Ex   += (trace(C0, n) + trace(C, n))       * 0.5 * dkx;
+            iOuts[n].Ix   += (get_flux(C0, n) + get_flux(C, n)) * 0.5 * dkx;
+            iOuts[n].EInx += (eqForcing.forsingPower(n, t0) + eqForcing.forsingPower(n, t)) * 0.5 * (t - t0);
+        }
+    }
+    for (size_t n = 0; n < N; ++n) {
+        iOuts[n].Ex += trace(C, n)    * 0.5 * dkx;
+        iOuts[n].Ix += get_flux(C, n) * 0.5 * dkx;
+    }
+
+    /* Every model stops on its own condition, as in a single run: its integrals get the end-point half and its block
+       is dropped from the stacked state, so it neither accumulates nor takes part in the step control any more. */
+    std::vector <size_t> active(N);
+    for (size_t n = 0; n < N; ++n) {
+        active[n] = n;
+    }
+    std::unique_ptr <LyapunovEquationWithMultipleForcing> eq(
+        new LyapunovEquationWithMultipleForcing(data, k, std::vector <Forcing> (N, Forcing::None)));
+    dkx = data.q * k.y() * eq->get_dt(t);
+    for (size_t n = 0; n < N; ++n) {
+        iOuts[n].Ex += trace(C, n)    * 0.5 * dkx;
+        iOuts[n].Ix += get_flux(C, n) * 0.5 * dkx;
+    }
+
+    int nSteps = 0;
+    const int nStepsMin = 10;
+    while (!active.empty()) {
+        const Matrix C0 = C;
+        double t0 = t;
 
-        finished = (k(t).x() > std::abs(kxMin)) && (nSteps > nStepsMin) && (trace(C) < 0.1 * iOut.EInx);
+        eq->make_step_forward(C, t);
+        dkx = data.q * k.y() * (t - t0);
+        const bool passed = (k(t).x() > std::abs(kxMin)) && (nSteps > nStepsMin);
+        std::vector <size_t> remaining;
+        for (size_t m = 0; m < active.size(); ++m) {
+            IntegratorOut& iOut = iOuts[active[m]];
+            iOut.Ex += (trace(C0, m) + trace(C, m))       * 0.5 * dkx;
+            iOut.Ix += (get_flux(C0, m) + get_flux(C, m)) * 0.5 * dkx;
+            if (passed && (trace(C, m) < 0.1 * iOut.EInx)) {
+                iOut.Ex += trace(C, m)    * 0.5 * dkx;
+                iOut.Ix += get_flux(C, m) * 0.5 * dkx;
+            } else {
+                remaining.push_back(m);
+            }
+        }
         ++nSteps;
+
+        if (remaining.size() < active.size()) {
+            Matrix CRemaining(4, 4 * remaining.size());
+            std::vector <size_t> activeRemaining;
+            for (size_t r = 0; r < remaining.size(); ++r) {
+                for (size_t i = 0; i < 4; ++i) {
+                    for (size_t j = 0; j < 4; ++j) {
+                        CRemaining(i, 4 * r + j) = C(i, 4 * remaining[r] + j);
+                    }
+                }
+                activeRemaining.push_back(active[remaining[r]]);
+            }
+            C = CRemaining;
+            active = activeRemaining;
+            eq.reset(new LyapunovEquationWithMultipleForcing(data, k, std::vector <Forcing> (active.size(),
+                                                                                             Forcing::None)));
+        }
     }
-    iOut.Ex += trace(C)    * 0.5 * dkx;
-    iOut.Ix += get_flux(C) * 0.5 * dkx;
 
-    return iOut;
+    return iOuts;
+}
+
+IntegratorOut extrapolateOverX(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                               Forcing forcing, int levels, IntegratorOut& error, CellCounters* counters) {
+    levels = std::max(levels, 1);
+
+    // T[i] holds the i-th column of the Richardson table, coarsest run first
+    std::vector <IntegratorOut> T(levels);
+    for (int i = 0; i < levels; ++i) {
+        const double Ct = data.Ct * std::pow(2.0, levels - 1 - i);
+        T[i] = integrateOverX(data.withCt(Ct), kxMin, kxMax, ky, kz, forcing, counters);
+    }
+    const IntegratorOut finest = T[levels - 1];
+
+    error = IntegratorOut();
+    for (int order = 1; order < levels; ++order) {
+        const double factor = 1.0 / (std::pow(2.0, order) - 1);
+        for (int i = levels - 1; i >= order; --i) {
+            IntegratorOut correction = T[i];
+            correction -= T[i - 1];
+            correction *= factor;
+            T[i] += correction;
+            if (i == levels - 1) {
+                error = correction;
+            }
+        }
+    }
+    error.Ex   = std::abs(error.Ex);
+    error.Ix   = std::abs(error.Ix);
+    error.EInx = std::abs(error.EInx);
+    for (double& value : error.reduced) {
+        value = std::abs(value);
+    }
+
+    // values of reducers which are not kx-integrals (e.g. the position of the peak) are not extrapolated
+    const std::vector <bool> integrals = Reducers(data).integrals();
+    error.reduced.resize(integrals.size(), 0);
+    for (size_t n = 0; n < integrals.size(); ++n) {
+        if (!integrals[n]) {
+            T[levels - 1].reduced[n] = finest.reduced[n];
+            error.reduced[n] = 0;
+        }
+    }
+    return T[levels - 1];
 }
 
 IntegratorOut integrateOverX(const Parameters& data, double kxMax, double ky, double kz) {
     return integrateOverX(data, -kxMax, kxMax, ky, kz);
 }
 
-void integrate(const Parameters& data, const WaveVector& kMax, double dky, double dkz) {
+IntegratorOut evaluateCell(const Parameters& data, double kxMin, double kxMax, double ky, double kz,
+                           IntegratorOut& error, CellCounters* counters) {
+    return extrapolateOverX(data, kxMin, kxMax, ky, kz, Forcing::Flat, data.richardson, error, counters);
+}
+
+namespace {
+
+/* integrate() with adaptive cubature over the rectangle of its grid nodes. Nodes of the cubature are written like the
+   cells of Spectra(ky, kz), the integral and its error estimate are appended to AdaptiveIntegratedSpectra. */
+void integrateAdaptive(const Parameters& data, const WaveVector& kMax, double dky, double dkz,
+                       const CellEvaluator& evaluate, bool output) {
+    const double kxMax  = kMax.x();
+    const double kyMax  = kMax.y();
+    const double kzMax  = kMax.z();
+
+    std::stringstream SpName;
+    SpName << boost::format("AdaptiveSpectra(ky, kz) R = %.0le R_b = %.0le kxMax = %.0lf kyMax = %.0lf kzMax = %.0lf") \
+        % (1.0 / data.invRe) % (1.0 / data.invRe_b) % kxMax % kyMax % kzMax;
+    std::ofstream fOut;
+    if (output) {
+        fOut.open(SpName.str());
+    }
+    data.outputTuning(fOut);
+
+    std::stringstream SpIntegratedName;
+    SpIntegratedName << \
+    boost::format("AdaptiveIntegratedSpectra R = %.0le R_b = %.0le") % (1.0 / data.invRe) % (1.0 / data.invRe_b);
+    std::ofstream fOutIntegrated;
+    if (output) {
+        fOutIntegrated.open(SpIntegratedName.str(), std::ios_base::app);
+    }
+
+    const int Ny = static_cast <int> (kyMax / dky) - 1;
+    const int Nz = static_cast <int> (kzMax / dkz);
+    const CubatureOut out = cubature(data, [&data, &evaluate, kxMax](double ky, double kz) {
+        IntegratorOut error;
+        return evaluate(data, -kxMax, kxMax, ky, kz, error, nullptr);
+    }, dky, Ny * dky, 0, (Nz - 1) * dkz, data.cubature);
+
+    for (const CubatureNode& node : out.nodes) {
+        fOut << node.kz << "\t" << node.ky << "\t" << node.iOut << "\n";
+    }
+
+    fOutIntegrated << data << "\t" << kxMax << "\t" << kyMax << "\t" << kzMax << "\t" << data.cubature << "\t" << \
+        out.nodes.size() << "\t" << out.integral << "\t" << out.error << "\n";
+}
+
+}  // namespace
+
+void integrate(const Parameters& data, const WaveVector& kMax, double dky, double dkz, const CellEvaluator& evaluate,
+               bool output) {
+    if (data.cubature > 0) {
+        integrateAdaptive(data, kMax, dky, dkz, evaluate, output);
+        return;
+    }
+
     const double kxMax  = kMax.x();
     const double kyMax  = kMax.y();
     const double kzMax  = kMax.z();
@@ -117,80 +538,108 @@ void integrate(const Parameters& data, const WaveVector& kMax, double dky, doubl
     SpName << boost::format("Spectra(ky, kz) R = %.0le R_b = %.0le kxMax = %.0lf kyMax = %.0lf kzMax = %.0lf") \
         % (1.0 / data.invRe) % (1.0 / data.invRe_b) % kxMax % kyMax % kzMax;
     std::ofstream fOut;
-    fOut.open(SpName.str());
+    if (output) {
+        fOut.open(SpName.str());
+    }
+    data.outputTuning(fOut);
 
     std::stringstream SpYName;
     SpYName << boost::format("Spectra(kz) R = %.0le R_b = %.0le kxMax = %.0lf kyMax = %.0lf kzMax = %.0lf") \
         % (1.0 / data.invRe) % (1.0 / data.invRe_b) % kxMax % kyMax % kzMax;
     std::ofstream fOutY;
-    fOutY.open(SpYName.str());
+    if (output) {
+        fOutY.open(SpYName.str());
+    }
+    data.outputTuning(fOutY);
 
     std::stringstream SpZName;
     SpZName << boost::format("Spectra(ky) R = %.0le R_b = %.0le kxMax = %.0lf kyMax = %.0lf kzMax = %.0lf") \
         % (1.0 / data.invRe) % (1.0 / data.invRe_b) % kxMax % kyMax % kzMax;
     std::ofstream fOutZ;
-    fOutZ.open(SpZName.str());
+    if (output) {
+        fOutZ.open(SpZName.str());
+    }
+    data.outputTuning(fOutZ);
 
     std::stringstream SpIntegratedName;
     SpIntegratedName << \
     boost::format("IntegratedSpectra R = %.0le R_b = %.0le") % (1.0 / data.invRe) % (1.0 / data.invRe_b);
     std::ofstream fOutIntegrated;
-    fOutIntegrated.open(SpIntegratedName.str(), std::ios_base::app);
+    if (output) {
+        fOutIntegrated.open(SpIntegratedName.str(), std::ios_base::app);
+    }
 
-    omp_set_num_threads(data.Nt);
+    setThreads(data);
 
     const int Ny = static_cast <int> (kyMax / dky) - 1;
     const int Nz = static_cast <int> (kzMax / dkz);
-    std::vector <std::vector <IntegratorOut>> iOuts(Ny, std::vector <IntegratorOut> (Nz));;
+
+    // trapezoid weight of n-th of N nodes
+    auto weight = [](int n, int N, double dk) {
+        return (N > 1 && (n == 0 || n == N - 1)) ? 0.5 * dk : dk;
+    };
+
+    /* Cells are written and reduced in the order of the output as soon as all preceding cells are done, so only the
+       marginals and the cells done ahead of the order are kept in memory. A cell is not started before the cell window
+       places before it is written, so a slow cell holds at most window pending cells. Sums do not depend on the number
+       of threads, Spectra(ky, kz) and Spectra(ky) grow row by row while the run goes. */
+    const int window = 256 * std::max(data.Nt, 1);
+    std::map <int, std::pair <IntegratorOut, CellCounters>> pending;
+    int nextCell = 0;
+    std::mutex outputMutex;
+    std::condition_variable written;
+    IntegratorOut iOutZ;
+    IntegratorOut iOutZY;
+    std::vector <IntegratorOut> iOutsY(Nz);
 
     const int N = Ny * Nz;
+    // counters of the cells travel with their pending results instead of a per-cell array of the whole grid
+    CountersOutput counters(data, 0);
+    Progress progress(data, "Spectra(ky, kz)", N);
     #pragma omp parallel for schedule(dynamic)
     for (int n = 0; n < N; ++n) {
-        const int ny = n % Ny;
-        const int nz = n / Ny;
-        const double ky = (ny + 1) * dky;
-        const double kz = nz * dkz;
-        iOuts[ny][nz] = integrateOverX(data, kxMax, ky, kz);
-    }
-
-    for (int ny = 0; ny < Ny; ++ny) {
-        for (int nz = 0; nz < Nz; ++nz) {
-            fOut << nz * dkz << "\t" << (ny + 1) * dky << "\t" << iOuts[ny][nz] << std::endl;
+        const double ky = (n / Nz + 1) * dky;
+        const double kz = (n % Nz) * dkz;
+        {
+            // cells are handed out in order, so the cell nextCell is already being computed by a thread which runs
+            std::unique_lock <std::mutex> lock(outputMutex);
+            written.wait(lock, [&]() { return n < nextCell + window; });
         }
-        fOut << "\n";
-    }
-
-    std::vector <IntegratorOut> iOutsZ(Ny);
-    IntegratorOut iOutZY;
-    for (int ny = 0; ny < Ny; ++ny) {
-        iOutsZ[ny] = (iOuts[ny][0] + iOuts[ny][Nz - 1]) * 0.5;
-        for (int nz = 1; nz < Nz - 1; ++nz) {
-            iOutsZ[ny] += iOuts[ny][nz];
+        IntegratorOut error;
+        CellCounters cellCounters;
+        const IntegratorOut iOut = evaluate(data, -kxMax, kxMax, ky, kz, error,
+                                            counters.enabled() ? &cellCounters : nullptr);
+        counters.add(cellCounters);
+        progress.add();
+
+        {
+            std::lock_guard <std::mutex> lock(outputMutex);
+            pending[n] = std::make_pair(iOut, cellCounters);
+            for (auto it = pending.begin(); it != pending.end() && it->first == nextCell; it = pending.erase(it)) {
+                const int ny = nextCell / Nz;
+                const int nz = nextCell % Nz;
+                fOut << nz * dkz << "\t" << (ny + 1) * dky << "\t" << it->second.first << std::endl;
+                counters.output(nz * dkz, (ny + 1) * dky, it->second.second);
+
+                iOutZ      += it->second.first * weight(nz, Nz, dkz);
+                iOutsY[nz] += it->second.first * weight(ny, Ny, dky);
+                if (nz == Nz - 1) {
+                    fOut << "\n";
+                    counters.endRow();
+                    fOutZ << (ny + 1) * dky << "\t" << iOutZ << std::endl;
+                    iOutZY += iOutZ * weight(ny, Ny, dky);
+                    iOutZ = IntegratorOut();
+                }
+                ++nextCell;
+            }
         }
-        iOutsZ[ny] *= dkz;
-        iOutZY += iOutsZ[ny];
+        written.notify_all();
     }
-    iOutZY -= (iOutsZ[0] + iOutsZ[Ny - 1]) * 0.5;
-    iOutZY *= dky;
 
-    std::vector <IntegratorOut> iOutsY(Nz);
     IntegratorOut iOutYZ;
-    for (int nz = 0; nz < Nz; ++nz) {
-        iOutsY[nz] = (iOuts[0][nz] + iOuts[Ny - 1][nz]) * 0.5;
-        for (int ny = 1; ny < Ny - 1; ++ny) {
-            iOutsY[nz] += iOuts[ny][nz];
-        }
-        iOutsY[nz] *= dky;
-        iOutYZ += iOutsY[nz];
-    }
-    iOutYZ -= (iOutsY[0] + iOutsY[Nz - 1]) * 0.5;
-    iOutYZ *= dkz;
-
-    for (int ny = 0; ny < Ny; ++ny) {
-        fOutZ << (ny + 1) * dky << "\t" << iOutsZ[ny] << "\n";
-    }
     for (int nz = 0; nz < Nz; ++nz) {
         fOutY << nz * dkz << "\t" << iOutsY[nz] << "\n";
+        iOutYZ += iOutsY[nz] * weight(nz, Nz, dkz);
     }
 
     fOutIntegrated << data << "\t" << kxMax << "\t" << kyMax << "\t" << kzMax << "\t" << dky << "\t" << dkz << "\t" << \
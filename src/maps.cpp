@@ -0,0 +1,198 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/maps.h"
+
+#include <omp.h>
+
+#include <ostream>
+#include <vector>
+#include <cmath>
+
+#include "include/Affinity.h"
+#include "include/Instrumentation.h"
+#include "include/Parameters.h"
+#include "include/Progress.h"
+#include "include/Reducers.h"
+#include "include/integrator.h"
+
+void mapKxKy(const Parameters& data, std::ostream& fOut, double dk,
+             double kxMin, double kxMax, double kyMin, double kyMax, double kz,
+             const CellEvaluator& evaluate) {
+    int Nx = static_cast <int> ((kxMax - kxMin) / dk);
+    int Ny = static_cast <int> ((kyMax - kyMin) / dk) + 1;
+
+    setThreads(data);
+    data.outputTuning(fOut);
+    outputReducedColumns(data, fOut);
+    std::vector <IntegratorOut> iOuts(Nx);
+    std::vector <IntegratorOut> errors(Nx);
+    CountersOutput counters(data, Nx);
+    Progress progress(data, "Map(kx,ky)", static_cast <uint64_t> (Nx) * Ny);
+    for (int ny = 0; ny < Ny; ++ny) {
+        const double ky = ny * dk + kyMin;
+        #pragma omp parallel for schedule(dynamic)
+        for (int nx = 0; nx < Nx; ++nx) {
+            const double kx = nx * dk + kxMin;
+            iOuts[nx] = evaluate(data, kx, kx + dk, ky, kz, errors[nx], counters.cell(nx));
+            counters.add(nx);
+            progress.add();
+        }
+        for (int nx = 0; nx < Nx; ++nx) {
+            const double kx = nx * dk + kxMin;
+            fOut << kx             << "\t" \
+                 << ky             << "\t" \
+                 << iOuts[nx].Ex   << "\t" \
+                 << iOuts[nx].Ix   << "\t" \
+                 << iOuts[nx].EInx;
+            if (data.richardson > 1) {
+                fOut << "\t" << errors[nx];
+            }
+            outputReduced(fOut, iOuts[nx]);
+            fOut << "\n";
+            counters.output(nx, kx, ky);
+        }
+        fOut << std::endl;
+        counters.endRow();
+    }
+}
+
+void mapKxKz(const Parameters& data, std::ostream& fOut, double dk,
+             double kxMin, double kxMax, double kzMin, double kzMax, double ky,
+             const CellEvaluator& evaluate) {
+    int Nx = static_cast <int> ((kxMax - kxMin) / dk);
+    int Nz = static_cast <int> ((kzMax - kzMin) / dk) + 1;
+
+    setThreads(data);
+    data.outputTuning(fOut);
+    outputReducedColumns(data, fOut);
+    std::vector <IntegratorOut> iOuts(Nx);
+    std::vector <IntegratorOut> errors(Nx);
+    CountersOutput counters(data, Nx);
+    Progress progress(data, "Map(kx,kz)", static_cast <uint64_t> (Nx) * Nz);
+    for (int nz = 0; nz < Nz; ++nz) {
+        const double kz = nz * dk + kzMin;
+        #pragma omp parallel for schedule(dynamic)
+        for (int nx = 0; nx < Nx; ++nx) {
+            const double kx = nx * dk + kxMin;
+            iOuts[nx] = evaluate(data, kx, kx + dk, ky, kz, errors[nx], counters.cell(nx));
+            counters.add(nx);
+            progress.add();
+        }
+        for (int nx = 0; nx < Nx; ++nx) {
+            const double kx = nx * dk + kxMin;
+            fOut << kx             << "\t" \
+                 << kz             << "\t" \
+                 << iOuts[nx].Ex   << "\t" \
+                 << iOuts[nx].Ix   << "\t" \
+                 << iOuts[nx].EInx;
+            if (data.richardson > 1) {
+                fOut << "\t" << errors[nx];
+            }
+            outputReduced(fOut, iOuts[nx]);
+            fOut << "\n";
+            counters.output(nx, kx, kz);
+        }
+        fOut << std::endl;
+        counters.endRow();
+    }
+}
+
+void mapKyKz(const Parameters& data, std::ostream& fOut, double dk,
+             double kyMin, double kyMax, double kzMin, double kzMax,
+             const CellEvaluator& evaluate) {
+    int Ny = static_cast <int> ((kyMax - kyMin) / dk) + 1;
+    int Nz = static_cast <int> ((kzMax - kzMin) / dk) + 1;
+
+    setThreads(data);
+    data.outputTuning(fOut);
+    outputReducedColumns(data, fOut);
+    std::vector <IntegratorOut> iOuts(Ny);
+    std::vector <IntegratorOut> errors(Ny);
+    CountersOutput counters(data, Ny);
+    Progress progress(data, "Map(ky,kz)", static_cast <uint64_t> (Ny) * Nz);
+    for (int nz = 0; nz < Nz; ++nz) {
+        const double kz = nz * dk + kzMin;
+        #pragma omp parallel for schedule(dynamic)
+        for (int ny = 0; ny < Ny; ++ny) {
+            const double ky = ny * dk + kyMin;
+            const double kx = -pow(data.q / data.invRe * ky, 1.0 / 3.0);
+            iOuts[ny] = evaluate(data, kx, kx + dk, ky, kz, errors[ny], counters.cell(ny));
+            counters.add(ny);
+            progress.add();
+        }
+        for (int ny = 0; ny < Ny; ++ny) {
+            const double ky = ny * dk + kyMin;
+            fOut << ky             << "\t" \
+                 << kz             << "\t" \
+                 << iOuts[ny].Ex   << "\t" \
+                 << iOuts[ny].Ix   << "\t" \
+                 << iOuts[ny].EInx;
+            if (data.richardson > 1) {
+                fOut << "\t" << errors[ny];
+            }
+            outputReduced(fOut, iOuts[ny]);
+            fOut << "\n";
+            counters.output(ny, ky, kz);
+        }
+        fOut << std::endl;
+        counters.endRow();
+    }
+}
+
+void relativeMapKyKz(const Parameters& data, std::ostream& fOut, double dk,
+                     double kyMin, double kyMax, double kzMin, double kzMax,
+                     const CellEvaluator& evaluate) {
+    int Ny = static_cast <int> ((kyMax - kyMin) / dk) + 1;
+    int Nz = static_cast <int> ((kzMax - kzMin) / dk) + 1;
+
+    setThreads(data);
+    data.outputTuning(fOut);
+    outputReducedColumns(data, fOut);
+    std::vector <IntegratorOut> iOuts(Ny);
+    std::vector <IntegratorOut> errors(Ny);
+    CountersOutput counters(data, Ny);
+    Progress progress(data, "RelMap(ky,kz)", static_cast <uint64_t> (Ny) * Nz);
+    std::vector <IntegratorOut> iOutsFlat(Ny);
+    for (int nz = 0; nz < Nz; ++nz) {
+        const double kz = nz * dk + kzMin;
+        #pragma omp parallel for schedule(dynamic)
+        for (int ny = 0; ny < Ny; ++ny) {
+            const double ky = ny * dk + kyMin;
+            const double kx = -pow(data.q / data.invRe * ky, 1.0 / 3.0);
+            iOuts[ny] = evaluate(data, kx, kx + dk, ky, kz, errors[ny], counters.cell(ny));
+            counters.add(ny);
+            progress.add();
+        }
+
+        if (nz == 0) {
+            iOutsFlat = iOuts;
+        }
+
+        for (int ny = 0; ny < Ny; ++ny) {
+            const double ky = ny * dk + kyMin;
+            fOut << ky                                  << "\t" \
+                 << kz                                  << "\t" \
+                 << iOuts[ny].Ex                        << "\t" \
+                 << iOuts[ny].Ix                        << "\t" \
+                 << iOuts[ny].EInx                      << "\t" \
+                 << iOuts[ny].Ex   / iOutsFlat[ny].Ex   << "\t" \
+                 << iOuts[ny].Ix   / iOutsFlat[ny].Ix   << "\t" \
+                 << iOuts[ny].EInx / iOutsFlat[ny].EInx;
+            if (data.richardson > 1) {
+                fOut << "\t" << errors[ny];
+            }
+            outputReduced(fOut, iOuts[ny]);
+            fOut << "\n";
+            counters.output(ny, ky, kz);
+        }
+        fOut << std::endl;
+        counters.endRow();
+    }
+}
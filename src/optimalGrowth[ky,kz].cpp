@@ -0,0 +1,58 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include <fstream>
+#include <string>
+#include <sstream>
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
+#include "include/Parameters.h"
+#include "include/TransientGrowth.h"
+
+namespace po = boost::program_options;
+
+int main(int ac, char **av) {
+    double kxMin;
+    double kxMax;
+    int nOut;
+
+    po::options_description options("Optimal growth options");
+    options.add_options()
+     ("kxMin", po::value <double> (&kxMin) -> default_value(-20), "Initial kx of SFH")
+     ("kxMax", po::value <double> (&kxMax) -> default_value(20),  "Final kx of SFH")
+     ("nOut",  po::value <int>    (&nOut)  -> default_value(400), "Number of output moments along SFH");
+
+    Parameters data(ac, av, options);
+    data.output();
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
+
+    const double dk    =  0.02;
+
+    const double kyMin =  dk;
+    const double kyMax =  4;
+
+    const double kzMin =  0;
+    const double kzMax =  4;
+
+    std::stringstream mapName;
+    mapName << boost::format("./map/Growth(ky,kz) R = %.0le R_b = %.0le dk = %.2lf kx = [%.1lf, %.1lf]") \
+        % (1.0 / data.invRe) % (1.0 / data.invRe_b) % dk % kxMin % kxMax;
+    std::ofstream fOut;
+    fOut.open(mapName.str());
+
+    growthMapKyKz(data, fOut, dk, kyMin, kyMax, kzMin, kzMax, kxMin, kxMax, nOut);
+
+    fOut.close();
+    return 0;
+}
@@ -7,42 +7,15 @@ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FO
 License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
 Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
-#include <omp.h>
-
-#include <fstream>
-#include <string>
-#include <sstream>
-#include <vector>
-#include <cmath>
-
-#include <boost/format.hpp>
-
+#include "include/Autotune.h"
+#include "include/Figures.h"
 #include "include/Parameters.h"
-#include "include/integrator.h"
-#include "include/WaveVector.h"
-
 
 int main(int ac, char **av) {
     Parameters data(ac, av);
     data.output();
 
-    const double ky        =  1.0;
-    const double kz        =  0.0;
-    const double kx        = -pow(data.q * ky / data.invRe, 1.0 / 3.0);
-
-    const double dk    =  0.005;
-
-    std::stringstream name;
-    name << boost::format("E(R) R_b = %.0le ky = %.2lf kz = %.2lf dk = %.3lf") \
-                                                                        % (1.0 / data.invRe_b) % (ky) % (kz) % dk;
-    std::ofstream fOut;
-    fOut.open(name.str(), std::ios_base::app);
+    optimalR(autotune(data, optimalR));
 
-    IntegratorOut iOut = integrateOverX(data, kx, kx + dk, ky, kz);
-    fOut << 1.0 / data.invRe << "\t" \
-         << iOut.Ex          << "\t" \
-         << iOut.Ix          << "\t" \
-         << iOut.EInx        << "\n";
-    fOut.close();
     return 0;
 }
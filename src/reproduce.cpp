@@ -0,0 +1,76 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "include/Figures.h"
+#include "include/Parameters.h"
+
+namespace po = boost::program_options;
+
+int main(int ac, char **av) {
+    std::vector <std::string> names;
+
+    po::options_description options("Reproduction options");
+    options.add_options()
+     ("figure", po::value <std::vector <std::string>> (&names) -> composing(),
+        "Make target of the figure, may be repeated, all figures by default");
+
+    Parameters data(ac, av, options);
+    data.output();
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
+
+    if (names.empty()) {
+        for (const auto& figure : figures()) {
+            names.push_back(figure.first);
+        }
+    }
+    for (const std::string& name : names) {
+        if (figures().count(name) == 0) {
+            std::cerr << "Unknown figure " << name << ", known figures are:";
+            for (const auto& figure : figures()) {
+                std::cerr << " " << figure.first;
+            }
+            std::cerr << std::endl;
+            return 1;
+        }
+    }
+
+    // figures are replayed without their own progress reports and counters
+    const Parameters quiet = data.withoutReports();
+    CellPool pool;
+    const CellEvaluator record = [&pool](const Parameters& d, double kxMin, double kxMax, double ky, double kz,
+                                         IntegratorOut& error, CellCounters* counters) {
+        return pool.record(d, kxMin, kxMax, ky, kz, error, counters);
+    };
+    const CellEvaluator lookup = [&pool](const Parameters& d, double kxMin, double kxMax, double ky, double kz,
+                                         IntegratorOut& error, CellCounters* counters) {
+        return pool.lookup(d, kxMin, kxMax, ky, kz, error, counters);
+    };
+
+    for (const std::string& name : names) {
+        figures().at(name)(quiet, record, false);
+    }
+    fprintf(stdout, "%zu cells requested by %zu figures, %zu distinct\n", pool.requested(), names.size(), pool.size());
+    fflush(stdout);
+
+    pool.run(data);
+
+    for (const std::string& name : names) {
+        figures().at(name)(quiet, lookup, true);
+    }
+    return 0;
+}
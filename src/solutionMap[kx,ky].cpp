@@ -7,60 +7,15 @@ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FO
 License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
 Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
-#include <omp.h>
-
-#include <fstream>
-#include <string>
-#include <sstream>
-#include <vector>
-
-#include <boost/format.hpp>
-
+#include "include/Autotune.h"
+#include "include/Figures.h"
 #include "include/Parameters.h"
-#include "include/integrator.h"
-#include "include/WaveVector.h"
-
 
 int main(int ac, char **av) {
     Parameters data(ac, av);
     data.output();
 
-    const double kz    = 0;
-
-    const double dk    = 0.02;
-    const double kyMin = dk;
-    const double kyMax =  3;
-    const double kxMin = -20;
-    const double kxMax =  20;
-
-    int Nx = static_cast <int> ((kxMax - kxMin) / dk);
-    int Ny = static_cast <int> ((kyMax - kyMin) / dk) + 1;
-
-    std::stringstream mapName;
-    mapName << boost::format("./map/Map(kx,ky) R = %.0le R_b = %.0le dk = %.2lf kz = %.1lf") \
-        % (1.0 / data.invRe) % (1.0 / data.invRe_b) % dk % kz;
-    std::ofstream fOut;
-    fOut.open(mapName.str());
+    solutionMapKxKy(autotune(data, solutionMapKxKy));
 
-    omp_set_num_threads(data.Nt);
-    std::vector <IntegratorOut> iOuts(Nx);
-    for (int ny = 0; ny < Ny; ++ny) {
-        const double ky = ny * dk + kyMin;
-        #pragma omp parallel for schedule(dynamic)
-        for (int nx = 0; nx < Nx; ++nx) {
-            const double kx = nx * dk + kxMin;
-            iOuts[nx] = integrateOverX(data, kx, kx + dk, ky, kz);
-        }
-        for (int nx = 0; nx < Nx; ++nx) {
-            const double kx = nx * dk + kxMin;
-            fOut << kx             << "\t" \
-                 << ky             << "\t" \
-                 << iOuts[nx].Ex   << "\t" \
-                 << iOuts[nx].Ix   << "\t" \
-                 << iOuts[nx].EInx << "\n";
-        }
-        fOut << std::endl;
-    }
-    fOut.close();
     return 0;
 }
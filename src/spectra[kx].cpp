@@ -11,6 +11,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <limits>
 
 #include <boost/numeric/odeint/integrate/integrate.hpp>
 #include <boost/numeric/odeint.hpp>
@@ -49,31 +50,27 @@ int main(int ac, char **av) {
     double t = 0;
     fSp << k.x(t) << "\t" << trace(C) << "\t" << get_flux(C) << "\t" << eqForcing.forsingPower(t) << "\n";
 
-    int nx = 0;
-    while (k.x(t) < kxMax) {
-        eqForcing.make_step_forward(C, t);
-        if (k.x(t) - kxMin > (nx + 1) * dkx) {
-            ++nx;
-            fSp << k.x(t) << "\t" << trace(C) << "\t" << get_flux(C) << "\t" << eqForcing.forsingPower(t) << "\n";
-        }
-    }
+    // spectrum points are interpolated to the kx grid, so steps are not limited by dkx
+    const double dtOut = dkx / (data.q * ky);
+    const double tForcing = (kxMax - kxMin) / (data.q * ky);
+    eqForcing.sample(C, t, tForcing, dtOut, [&](double tOut, const Matrix& COut) {
+        fSp << k.x(tOut) << "\t" << trace(COut) << "\t" << get_flux(COut) << "\t" << eqForcing.forsingPower(tOut) \
+            << "\n";
+        return true;
+    });
 
     LyapunovEquationWithoutForcing eq(data, k);
-    bool finished = false;
-    int  nSteps   = 0;
-    const int nStepsMin = 10;
-    while (finished == false) {
-        eq.make_step_forward(C, t);
-        if (k.x(t) - kxMin > (nx + 1) * dkx) {
-            ++nx;
-            fSp << k.x(t) << "\t" << trace(C) << "\t" << get_flux(C) << "\n";
-        }
-        finished = (k(t).x() > 0) && \
-                   (nSteps > nStepsMin) && \
-                   (trace(C) < 1) && \
-                   (trace(C) < (kxMax - kxMin) * eqForcing.forsingPower(t));
-        ++nSteps;
-    }
+    int nOut = 0;
+    const int nOutMin = 10;
+    eq.sample(C, t, std::numeric_limits <double>::infinity(), dtOut, [&](double tOut, const Matrix& COut) {
+        fSp << k.x(tOut) << "\t" << trace(COut) << "\t" << get_flux(COut) << "\n";
+        ++nOut;
+        const bool finished = (k(tOut).x() > 0) && \
+                              (nOut > nOutMin) && \
+                              (trace(COut) < 1) && \
+                              (trace(COut) < (kxMax - kxMin) * eqForcing.forsingPower(tOut));
+        return !finished;
+    });
 
     IntegratorOut iOut = integrateOverX(data, kxMin, kxMax, ky, kz);
     fprintf(stdout, "kz    = %lf\n", kz);
@@ -7,22 +7,15 @@ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FO
 License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
 Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
+#include "include/Autotune.h"
+#include "include/Figures.h"
 #include "include/Parameters.h"
-#include "include/integrator.h"
-#include "include/WaveVector.h"
 
 int main(int ac, char **av) {
     Parameters data(ac, av);
     data.output();
 
-    const double kxMax  = 5;
-    const double kyMax  = 2;
-    const double kzMax  = 2;
-
-    const double dky = 0.1;
-    const double dkz = 0.1;
-
-    integrate(data, WaveVector(data, kxMax, kyMax, kzMax), dky, dkz);
+    spectraKyKz(autotune(data, spectraKyKz));
 
     return 0;
 }
@@ -7,109 +7,242 @@ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FO
 License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
 Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <stdexcept>
 #include <string>
 #include <sstream>
 #include <vector>
 
-#include <boost/numeric/odeint/integrate/integrate.hpp>
-#include <boost/numeric/odeint.hpp>
 #include <boost/format.hpp>
+#include <boost/program_options.hpp>
 
+#include "include/Affinity.h"
 #include "include/Parameters.h"
 #include "include/LyapunovEquations.h"
-
-namespace ode = boost::numeric::odeint;
-
-void spectraOut(const std::vector <WaveVector>& k, const std::vector <Matrix>& C, const Parameters& data, double t) {
-    std::stringstream SpName;
-    SpName << boost::format("NonSteadySpectra R=%.0le R_b=%.1le ky=%.2lf kz=%.1lf t=%.3lf") \
-    % (1.0 / data.invRe) % (1.0 / data.invRe_b) % (k[0].y()) % (k[0].z()) % (t);
-    std::ofstream fSp;
-    fSp.open(SpName.str());
-
-    for (uint i = 0; i < k.size(); ++i) {
-        fSp << k[i].x(t) << "\t" << trace(C[i]) << "\n";
+#include "include/Progress.h"
+
+namespace po = boost::program_options;
+
+// energy density over bins of width dk, only bins that got harmonics are written
+class Spectrum {
+ private:
+    double _kMin;
+    double _dk;
+    std::vector <double> _E;
+    std::vector <uint64_t> _n;
+
+ public:
+    Spectrum(double kMin, double kMax, double dk) :
+        _kMin(kMin),
+        _dk(dk),
+        _E(static_cast <size_t> ((kMax - kMin) / dk) + 2, 0),
+        _n(_E.size(), 0) {}
+
+    // E is the energy of the harmonic times its volume in the wave-vector space
+    inline void add(double k, double E) {
+        const long i = std::lround((k - _kMin) / _dk);
+        if ((i >= 0) && (static_cast <size_t> (i) < _E.size())) {
+            _E[i] += E / _dk;
+            ++_n[i];
+        }
     }
 
-    fSp.close();
-}
+    Spectrum& operator += (const Spectrum& rhs) {
+        for (size_t i = 0; i < _E.size(); ++i) {
+            _E[i] += rhs._E[i];
+            _n[i] += rhs._n[i];
+        }
+        return *this;
+    }
 
-void addPointOfSingleSFH(const WaveVector& k, const Matrix C, const Parameters& data, double t) {
-    std::stringstream SpName;
-    SpName << boost::format("SteadySpectra R=%.0le R_b=%.1le ky=%.2lf kz=%.1lf") \
-    % (1.0 / data.invRe) % (1.0 / data.invRe_b) % (k.y()) % (k.z());
-    std::ofstream fSp;
-    fSp.open(SpName.str(), std::ios_base::app);
+    void write(const std::string& name) const {
+        std::ofstream fSp;
+        fSp.open(name);
+        for (size_t i = 0; i < _E.size(); ++i) {
+            if (_n[i] > 0) {
+                fSp << _kMin + _dk * static_cast <double> (i) << "\t" << _E[i] << "\n";
+            }
+        }
+    }
+};
+
+// marginal spectra over kx, ky, kz and spectrum over shells of |k| at one moment
+struct Snapshot {
+ public:
+    Spectrum kx;
+    Spectrum ky;
+    Spectrum kz;
+    Spectrum k;
+
+    Snapshot& operator += (const Snapshot& rhs) {
+        kx += rhs.kx;
+        ky += rhs.ky;
+        kz += rhs.kz;
+        k  += rhs.k;
+        return *this;
+    }
+};
+
+// advances C from t to tEnd and observes it at multiples of dtOut
+void evolve(const AbstractLyapunovEquation& eq, Stepper stepper, Matrix& C, double& t, double tEnd, double dtOut,
+            const Observer& observer) {
+    if (stepper == Stepper::RungeKutta) {
+        eq.sample(C, t, tEnd, dtOut, observer);
+        return;
+    }
 
-    fSp << k.x(t) << "\t" << trace(C) << "\n";
-    fSp.close();
+    MagnusPropagator magnus(eq, t);
+    double E   = 0;
+    double I   = 0;
+    double EIn = 0;
+    const double eps = 1e-9 * dtOut;
+    double n = std::floor((t + eps) / dtOut) + 1;
+    while (t < tEnd) {
+        const double tOut = std::min(n * dtOut, tEnd);
+        while (magnus.make_step_forward(C, t, tOut, E, I, EIn) == false) {}
+        if (n * dtOut <= tEnd + eps) {
+            observer(t, C);
+            n += 1;
+        }
+    }
 }
 
 int main(int ac, char **av) {
-    Parameters data(ac, av);
+    double kxMin, kxMax, dkx;
+    double kyMin, kyMax;
+    double kzMin, kzMax;
+    int nKy, nKz;
+    double kxFMin, kxFMax;
+    double tCalc, dtCalc;
+
+    po::options_description options("Wave-vector set");
+    options.add_options()
+     ("kxMin",  po::value <double> (&kxMin)  -> default_value(-50),  "Minimal initial kx of SFHs")
+     ("kxMax",  po::value <double> (&kxMax)  -> default_value(20),   "Maximal initial kx of SFHs")
+     ("dkx",    po::value <double> (&dkx)    -> default_value(0.1),  "Step of initial kx and width of spectral bins")
+     ("kyMin",  po::value <double> (&kyMin)  -> default_value(1),    "Minimal ky, must be positive")
+     ("kyMax",  po::value <double> (&kyMax)  -> default_value(1),    "Maximal ky")
+     ("nKy",    po::value <int> (&nKy)       -> default_value(1),    "Number of ky")
+     ("kzMin",  po::value <double> (&kzMin)  -> default_value(0),    "Minimal kz")
+     ("kzMax",  po::value <double> (&kzMax)  -> default_value(0),    "Maximal kz")
+     ("nKz",    po::value <int> (&nKz)       -> default_value(1),    "Number of kz")
+     ("kxFMin", po::value <double> (&kxFMin) -> default_value(-3.5), "Forcing acts for kx > kxFMin")
+     ("kxFMax", po::value <double> (&kxFMax) -> default_value(3.5),  "Forcing acts for kx < kxFMax")
+     ("tCalc",  po::value <double> (&tCalc)  -> default_value(30),   "Duration of evolution")
+     ("dtCalc", po::value <double> (&dtCalc) -> default_value(5),    "Interval between snapshots");
+
+    Parameters data(ac, av, options);
     data.output();
 
-    const double ky     =  1.0;
-    const double kz     =  0.0;
-    const double kxFMax =  3.5;
-    const double kxFMin = -3.5;
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
 
-    const double kxMax  =   20.0;
-    const double kxMin  =  -50.0;
-    const double dkx    =   0.1;
-    const double dt     =   1e-3 / (data.q * ky);
-
-    const int nKx       = static_cast <int> ((kxMax - kxMin) / dkx) + 1;
-    std::vector <double> kx;
-    for (int iKx = 0; iKx < nKx; ++iKx) {
-        kx.push_back(kxMax - dkx * iKx);
+    if ((kyMin <= 0) || (nKy < 1) || (nKz < 1)) {
+        fprintf(stderr, "kyMin must be positive, nKy and nKz at least 1\n");
+        return 1;
     }
-
-    int iKFirst = nKx - static_cast <int> ((kxFMin - kxMin) / dkx) - 1;
-
-    std::vector <WaveVector> k;
-    std::vector <LyapunovEquationWithFlatForcing> eqForcing;
-    std::vector <LyapunovEquationWithoutForcing> eqFree;
-    std::vector <Matrix> C;
-    std::vector <double> tMax;
-    for (uint i = 0; i < kx.size(); ++i) {
-        k.emplace_back(data, kx[i], ky, kz);
-        eqForcing.emplace_back(data, k[i]);
-        eqFree.emplace_back(data, k[i]);
-        C.emplace_back(ZeroMatrix(4, 4));
-        tMax.push_back((kxFMax - kx[i]) / ky / data.q);
+    // the tracked SFH starts at kxFMin, which must be on the grid of initial kx
+    if (!((kxMin <= kxFMin) && (kxFMin < kxMax))) {
+        throw std::invalid_argument("kxFMin must satisfy kxMin <= kxFMin < kxMax");
     }
 
-    double t = 0;
-    spectraOut(k, C, data, t);
-    addPointOfSingleSFH(k[iKFirst], C[iKFirst], data, t);
-
-    const double tCalc  = 30;
-    const double dtCalc = 5;
-    for (int j = 1; j <= tCalc / dtCalc; ++j) {
-        while (t < dtCalc * j) {
-            #pragma omp parallel for
-            for (uint i = 0; i < k.size(); ++i) {
-                double tLocal   = t;
-                double tMaxStep = std::min(t + dt, tMax[i]);
-
-                bool finished = false;
-                if ((k[i].x(tMaxStep) > kxFMin) && (k[i].x(t) < kxFMax)) {
-                    while (finished == false) {
-                        finished = eqForcing[i].make_step_forward(C[i], tLocal, tMaxStep);
-                    }
+    // SFHs are enumerated on the fly, nothing is stored per SFH
+    const uint64_t nKx = static_cast <uint64_t> ((kxMax - kxMin) / dkx) + 1;
+    const uint64_t N   = nKx * static_cast <uint64_t> (nKy) * static_cast <uint64_t> (nKz);
+    const double dky   = (nKy > 1) ? (kyMax - kyMin) / (nKy - 1) : 1;
+    const double dkz   = (nKz > 1) ? (kzMax - kzMin) / (nKz - 1) : 1;
+    const double dV    = dkx * dky * dkz;
+
+    const int nOut = static_cast <int> (tCalc / dtCalc);
+    const double kxOutMax = kxMax + data.q * kyMax * tCalc;
+    const double kOutMax  = std::sqrt(std::pow(std::max(std::abs(kxMin), kxOutMax), 2) + kyMax * kyMax +
+                                      std::max(kzMin * kzMin, kzMax * kzMax));
+    const Snapshot empty{Spectrum(kxMin, kxOutMax, dkx), Spectrum(kyMin, kyMax, dky), Spectrum(kzMin, kzMax, dkz),
+                         Spectrum(0, kOutMax, dkx)};
+    std::vector <Snapshot> snapshots(nOut + 1, empty);
+
+    // single SFH which starts at the lower boundary of the forcing band
+    const uint64_t iKFirst = nKx - static_cast <uint64_t> ((kxFMin - kxMin) / dkx) - 1;
+    std::vector <double> single(nOut + 1, 0);
+
+    setThreads(data);
+    Progress progress(data, "SFHs", N);
+    #pragma omp parallel
+    {
+        std::vector <Snapshot> local(nOut + 1, empty);
+
+        #pragma omp for schedule(dynamic, 64)
+        for (uint64_t n = 0; n < N; ++n) {
+            const uint64_t iKx = n % nKx;
+            const uint64_t iKy = (n / nKx) % static_cast <uint64_t> (nKy);
+            const uint64_t iKz = n / nKx / static_cast <uint64_t> (nKy);
+            const WaveVector k(data, kxMax - dkx * static_cast <double> (iKx), kyMin + dky * static_cast <double> (iKy),
+                               kzMin + dkz * static_cast <double> (iKz));
+            const LyapunovEquationWithFlatForcing eqForcing(data, k);
+            const LyapunovEquationWithoutForcing eqFree(data, k);
+
+            const bool tracked = (iKx == iKFirst) && (iKy == 0) && (iKz == 0);
+            const Observer snapshot = [&](double tOut, const Matrix& COut) {
+                const size_t j = static_cast <size_t> (std::lround(tOut / dtCalc));
+                const double E = trace(COut);
+                local[j].kx.add(k.x(tOut), E * dV);
+                local[j].ky.add(k.y(), E * dV);
+                local[j].kz.add(k.z(), E * dV);
+                local[j].k.add(abs(k(tOut)), E * dV);
+                if (tracked) {
+                    single[j] = E;
                 }
+                return true;
+            };
+
+            const double tMin = std::min(std::max((kxFMin - k.x()) / k.y() / data.q, 0.0), tCalc);
+            const double tMax = std::min(std::max((kxFMax - k.x()) / k.y() / data.q, 0.0), tCalc);
+            Matrix C = ZeroMatrix(4, 4);
+            double t = 0;
+            snapshot(t, C);
+            evolve(eqFree,    data.freeStepper,   C, t, tMin,  dtCalc, snapshot);
+            evolve(eqForcing, data.forcedStepper, C, t, tMax,  dtCalc, snapshot);
+            evolve(eqFree,    data.freeStepper,   C, t, tCalc, dtCalc, snapshot);
+            progress.add();
+        }
 
-                finished = false;
-                while (finished == false) {
-                    finished = eqFree[i].make_step_forward(C[i], tLocal, t + dt);
-                }
-            }
-            t += dt;
+        #pragma omp critical(snapshots)
+        for (int j = 0; j <= nOut; ++j) {
+            snapshots[j] += local[j];
+        }
+    }
+
+    for (int j = 0; j <= nOut; ++j) {
+        const double t = dtCalc * j;
+        const std::string suffix = (boost::format(" R=%.0le R_b=%.1le t=%.3lf") % (1.0 / data.invRe) %
+                                    (1.0 / data.invRe_b) % t).str();
+        // the kx spectrum keeps the name of the single-line version of the driver
+        snapshots[j].kx.write((boost::format("NonSteadySpectra R=%.0le R_b=%.1le ky=%.2lf kz=%.1lf t=%.3lf") %
+                               (1.0 / data.invRe) % (1.0 / data.invRe_b) % kyMin % kzMin % t).str());
+        if (nKy > 1) {
+            snapshots[j].ky.write("NonSteadySpectra(ky)" + suffix);
+        }
+        if (nKz > 1) {
+            snapshots[j].kz.write("NonSteadySpectra(kz)" + suffix);
         }
-        spectraOut(k, C, data, t);
-        addPointOfSingleSFH(k[iKFirst], C[iKFirst], data, t);
+        snapshots[j].k.write("NonSteadySpectra(k)" + suffix);
+    }
+
+    std::stringstream SpName;
+    SpName << boost::format("SteadySpectra R=%.0le R_b=%.1le ky=%.2lf kz=%.1lf") \
+    % (1.0 / data.invRe) % (1.0 / data.invRe_b) % (kyMin) % (kzMin);
+    std::ofstream fSp;
+    fSp.open(SpName.str(), std::ios_base::app);
+    const WaveVector kFirst(data, kxMax - dkx * static_cast <double> (iKFirst), kyMin, kzMin);
+    for (int j = 0; j <= nOut; ++j) {
+        fSp << kFirst.x(dtCalc * j) << "\t" << single[j] << "\n";
     }
     return 0;
 }
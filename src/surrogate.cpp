@@ -0,0 +1,110 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "include/integrator.h"
+#include "include/Parameters.h"
+#include "include/Surrogate.h"
+
+namespace po = boost::program_options;
+
+int main(int ac, char **av) {
+    std::string mode;
+    std::string fileName;
+    SurrogateBox box;
+    double dk;
+    int heldOut;
+    double tolerance;
+
+    po::options_description options("Surrogate options");
+    options.add_options()
+     ("mode",      po::value <std::string> (&mode)     -> default_value("build"),
+        "build: fit the model over the box, query: evaluate kx ky kz lines of stdin")
+     ("file",      po::value <std::string> (&fileName) -> default_value("./surrogate.dat"), "Model file")
+     ("kxMin",     po::value <double> (&box.kMin[0])   -> default_value(-20),  "Minimal kx of the box")
+     ("kxMax",     po::value <double> (&box.kMax[0])   -> default_value(20),   "Maximal kx of the box")
+     ("kyMin",     po::value <double> (&box.kMin[1])   -> default_value(0.5),  "Minimal ky of the box")
+     ("kyMax",     po::value <double> (&box.kMax[1])   -> default_value(3),    "Maximal ky of the box")
+     ("kzMin",     po::value <double> (&box.kMin[2])   -> default_value(0),    "Minimal kz of the box")
+     ("kzMax",     po::value <double> (&box.kMax[2])   -> default_value(0),    "Maximal kz of the box")
+     ("patchesX",  po::value <int> (&box.patches[0])   -> default_value(16),   "Patches along kx")
+     ("patchesY",  po::value <int> (&box.patches[1])   -> default_value(2),    "Patches along ky")
+     ("patchesZ",  po::value <int> (&box.patches[2])   -> default_value(1),    "Patches along kz")
+     ("degree",    po::value <int> (&box.degree)       -> default_value(8),    "Chebyshev degree of the patches")
+     ("dk",        po::value <double> (&dk)            -> default_value(0.02), "Width of the cells in kx")
+     ("heldOut",   po::value <int> (&heldOut)          -> default_value(4),    "Held-out cells per patch")
+     ("tolerance", po::value <double> (&tolerance)     -> default_value(1e-3),
+        "Error estimate above which queries are integrated");
+
+    Parameters data(ac, av, options);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(ac, av).options(options).allow_unregistered().run(), vm);
+    po::notify(vm);
+
+    if (mode == "build") {
+        data.output();
+        const double start = omp_get_wtime();
+        const Surrogate surrogate(data, box, dk, heldOut);
+        surrogate.save(fileName);
+        const std::vector <double>& errors = surrogate.errors();
+        double mean = 0;
+        for (double error : errors) {
+            mean += error / static_cast <double> (errors.size());
+        }
+        fprintf(stdout, "%zu patches, error estimates: max %.3le, mean %.3le, %.1lf s\n", errors.size(),
+                *std::max_element(errors.begin(), errors.end()), mean, omp_get_wtime() - start);
+        return 0;
+    }
+
+    if (mode != "query") {
+        fprintf(stderr, "Unknown mode %s\n", mode.c_str());
+        return 1;
+    }
+
+    // the model carries its own parameters, cells outside of it are integrated with them
+    const Surrogate surrogate = Surrogate::load(fileName);
+    surrogate.parameters().output();
+    std::string line;
+    size_t nModel = 0;
+    double modelTime = 0;
+    while (std::getline(std::cin, line)) {
+        std::stringstream ss(line);
+        double kx, ky, kz;
+        if (!(ss >> kx >> ky >> kz)) {
+            continue;
+        }
+        bool integrated = false;
+        const double start = omp_get_wtime();
+        const IntegratorOut iOut = surrogate.query(kx, ky, kz, tolerance, integrated);
+        if (!integrated) {
+            modelTime += omp_get_wtime() - start;
+            ++nModel;
+        }
+        double error = 0;
+        if (surrogate.contains(kx, ky, kz)) {
+            surrogate.evaluate(kx, ky, kz, error);
+        }
+        fprintf(stdout, "%lg\t%lg\t%lg\t%.10lg\t%.10lg\t%.10lg\t%.3le\t%s\n", kx, ky, kz, iOut.Ex, iOut.Ix, iOut.EInx,
+                error, integrated ? "integrated" : "model");
+    }
+    if (nModel > 0) {
+        const double perQuery = modelTime / static_cast <double> (nModel);
+        fprintf(stderr, "%zu model queries, %.0lf ns per query\n", nModel, 1e9 * perQuery);
+    }
+    return 0;
+}
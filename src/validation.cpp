@@ -0,0 +1,110 @@
+// Copyright 2019 Dmitry N. Razdoburdin.
+
+/* This file is part of DOKFUSF. DOKFUSF is a program that calculats dynamic of Keplerian flow under stochastic forcing.
+DOKFUSF is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later version. DOKFUSF is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+License for more details. You should have received a copy of the GNU General Public License along with DOKFUSF; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
+
+#include "include/validation.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "include/Affinity.h"
+#include "include/integrator.h"
+#include "include/LyapunovEquations.h"
+#include "include/Parameters.h"
+
+inline double inverse(double x) {
+    return x > 0 ? 1.0 / x : INFINITY;
+}
+
+std::vector <ValidationCase> readReference(const std::string& name) {
+    std::vector <ValidationCase> cases;
+    std::ifstream fIn(name);
+    std::string line;
+    while (std::getline(fIn, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::stringstream ss(line);
+        std::string kxMin, kxMax, ky, kz, R, R_b, forcing, Ex, Ix, EInx;
+        ss >> kxMin >> kxMax >> ky >> kz >> R >> R_b >> forcing >> Ex >> Ix >> EInx;
+
+        ValidationCase c = {std::stod(kxMin), std::stod(kxMax), std::stod(ky), std::stod(kz),
+                            inverse(std::stod(R)), inverse(std::stod(R_b)), forcingFromName(forcing), IntegratorOut()};
+        c.reference.Ex   = std::stod(Ex);
+        c.reference.Ix   = std::stod(Ix);
+        c.reference.EInx = std::stod(EInx);
+        cases.push_back(c);
+    }
+    return cases;
+}
+
+void writeReference(const std::string& name, const std::vector <ValidationCase>& cases, double Ct) {
+    std::ofstream fOut(name);
+    fOut << "# reference values of integrateOverX computed with Ct = " << Ct << "\n";
+    fOut << "# kxMin\tkxMax\tky\tkz\tR\tR_b\tforcing\tEx\tIx\tEInx\n";
+    fOut.precision(12);
+    for (const ValidationCase& c : cases) {
+        fOut << c.kxMin << "\t" << c.kxMax << "\t" << c.ky << "\t" << c.kz << "\t" \
+             << inverse(c.invRe) << "\t" << inverse(c.invRe_b) << "\t" << forcingName(c.forcing) << "\t" \
+             << c.reference << "\n";
+    }
+}
+
+void computeReference(const Parameters& data, std::vector <ValidationCase>& cases, double Ct) {
+    setThreads(data);
+    const int N = static_cast <int> (cases.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int n = 0; n < N; ++n) {
+        ValidationCase& c = cases[n];
+        const Parameters referenceData = c.parameters(data).withCt(Ct).withRichardson(1)
+                                          .withSteppers(Stepper::RungeKutta, Stepper::RungeKutta);
+        c.reference = integrateOverX(referenceData, c.kxMin, c.kxMax, c.ky, c.kz, c.forcing);
+    }
+}
+
+double relativeError(const IntegratorOut& iOut, const IntegratorOut& reference) {
+    double error = std::abs(iOut.Ex - reference.Ex) / std::abs(reference.Ex);
+    const double IxScale = std::max(std::abs(reference.Ix), 1e-3 * std::abs(reference.Ex));
+    error = std::max(error, std::abs(iOut.Ix - reference.Ix) / IxScale);
+    error = std::max(error, std::abs(iOut.EInx - reference.EInx) / std::abs(reference.EInx));
+    return error;
+}
+
+std::vector <ModeReport> validate(const Parameters& data, const std::vector <ValidationCase>& cases,
+                                  const std::vector <Mode>& modes) {
+    std::vector <ModeReport> reports;
+    for (const Mode& mode : modes) {
+        ModeReport report = {mode.name, 0, 0, 0, true};
+        for (const ValidationCase& c : cases) {
+            const Parameters caseData = c.parameters(data);
+            const double start = omp_get_wtime();
+            const IntegratorOut iOut = mode.integrate(caseData, c);
+            report.time += omp_get_wtime() - start;
+
+            const double error = relativeError(iOut, c.reference);
+            report.maxError   = std::max(report.maxError, error);
+            report.meanError += error / static_cast <double> (cases.size());
+        }
+        reports.push_back(report);
+    }
+
+    for (ModeReport& report : reports) {
+        for (const ModeReport& other : reports) {
+            if ((other.time < report.time) && (other.maxError < report.maxError)) {
+                report.pareto = false;
+            }
+        }
+    }
+    return reports;
+}